@@ -15,23 +15,38 @@
  *     the Free Software Foundation; either version 2 of the License, or
  *     (at your option) any later version.
  */
-#include <cassert>
+#include <algorithm>
 #include <iostream>
 
 #include "analyser.hpp"
+#include "database.hpp"
 #include "instruction.hpp"
 #include "image.hpp"
 #include "label.hpp"
 #include "le.hpp"
+#include "parallel.hpp"
 #include "regions.hpp"
+#include "util.hpp"
 
 using std::ios;
 
-void
-Analyser::add_region (const Region &reg)
+/* Longest instruction the disassembler may need to see */
+static const size_t max_instruction_size = 32;
+
+/* Rounds smaller than this are not worth starting the threads */
+static const size_t min_parallel_round = 64;
+
+/* Guesses still plausible after this many instructions are accepted */
+static const size_t max_guess_instructions = 1024;
+
+struct Analyser::TracedInstruction
 {
-  this->regions[reg.get_address ()] = reg;
-}
+  uint32_t          address;
+  uint32_t          length;   /* bytes the disassembler was allowed to see */
+  uint32_t          size;
+  Instruction::Type type;
+  uint32_t          target;
+};
 
 void
 Analyser::add_initial_regions (void)
@@ -40,6 +55,12 @@ Analyser::add_initial_regions (void)
   size_t n;
   Region::Type type;
 
+  this->shadow.clear ();
+  this->regions_dirty = true;
+  this->cfg_dirty = true;
+  this->data_types_dirty = true;
+  this->xrefs_dirty = true;
+
   for (n = 0; n < this->le->get_object_count (); n++)
   {
     ohdr = this->le->get_object_header (n);
@@ -52,8 +73,7 @@ Analyser::add_initial_regions (void)
     else
       type = Region::UNKNOWN;
 
-    this->add_region (Region (ohdr->base_address,
-                      ohdr->virtual_size, type));
+    this->shadow.add_object (ohdr->base_address, ohdr->virtual_size, type);
   }
 }
 
@@ -74,9 +94,9 @@ Analyser::add_eip_to_trace_queue (void)
 void
 Analyser::add_labels_to_trace_queue (void)
 {
-  for (auto it = this->labels.begin(); it != this->labels.end(); it++)
+  for (size_t n = 0; n < this->labels.size (); n++)
     {
-      Label *label = &it->second;
+      const Label *label = &this->labels.get_sorted (n);
       if (label->get_type() == Label::FUNCTION or label->get_type() == Label::JUMP)
         this->add_code_trace_address (label->get_address());
     }
@@ -85,7 +105,29 @@ Analyser::add_labels_to_trace_queue (void)
 void
 Analyser::add_code_trace_address (uint32_t addr)
 {
-  this->code_trace_queue.push_back (addr);
+  this->trace_log.edit ()->add_target (addr);
+  this->queue_code_trace (addr);
+}
+
+void
+Analyser::queue_code_trace (uint32_t addr)
+{
+  uint8_t flags;
+
+  if (this->shadow.contains_address (addr))
+    {
+      flags = this->shadow.get_flags (addr);
+
+      /* Only a jump into middle of instruction is worth a second look */
+      if ((flags & ShadowMap::QUEUED) != 0
+          or (flags & ShadowMap::CODE_START) != 0)
+        return;
+
+      this->shadow.set_flag (addr, ShadowMap::QUEUED);
+    }
+
+  this->code_trace_queue.push (addr);
+  this->schedule (TASK_TRACE);
 }
 
 void
@@ -93,328 +135,676 @@ Analyser::trace_code (void)
 {
   uint32_t address;
 
+  if (this->jobs > 1 and this->code_trace_queue.get_order () == TraceQueue::FIFO)
+    {
+      this->trace_code_parallel ();
+      return;
+    }
+
   while (!this->code_trace_queue.empty ())
   {
-    address = this->code_trace_queue.front ();
-    this->code_trace_queue.pop_front ();
+    address = this->code_trace_queue.pop ();
     this->trace_code_at_address (address);
   }
 }
 
+/** Traces the queue in rounds, decoding blocks of each round in parallel.
+ *
+ * A round consists of all addresses queued when it starts, in queue
+ * order, so processing rounds one after another is the same as FIFO.
+ * Blocks are decoded by workers against the state at start of the round,
+ * then merged in queue order, each being checked against the state left
+ * by blocks merged before it.
+ */
 void
-Analyser::trace_code_at_address (uint32_t start_addr)
+Analyser::trace_code_parallel (void)
 {
-  Region *reg;
-  size_t end_addr;
-  size_t addr;
-  const Image::Object *obj;
-  const Image::DataVector *data;
-  Instruction inst;
-  const void *data_ptr;
+  std::vector<uint32_t> round;
+  std::vector<TraceBlock> blocks;
+  std::vector<Disassembler> disasms (this->jobs, this->disasm);
+  size_t n;
 
-  reg = this->get_region_at_address (start_addr);
-  if (reg == NULL)
+  while (!this->code_trace_queue.empty ())
     {
-      std::cerr << "Warning: Tried to trace code at an unmapped address: 0x"
-                << std::hex << start_addr << ".\n";
-      return;
-    }
+      round.clear ();
 
-  if (reg->get_type () == Region::CODE) /* already traced */
-    return;
+      while (!this->code_trace_queue.empty ())
+        round.push_back (this->code_trace_queue.pop ());
 
-  end_addr = reg->get_end_address ();
-  obj = this->image->get_object_at_address (start_addr);
-  data = obj->get_data ();
+      if (round.size () < min_parallel_round)
+        {
+          for (n = 0; n < round.size (); n++)
+            this->trace_code_at_address (round[n]);
+          continue;
+        }
 
-  addr = start_addr;
+      blocks.resize (round.size ());
 
-  while (addr < end_addr)
-  {
-    data_ptr = &data->front () + addr - obj->get_base_address ();
-    this->disasm.disassemble (addr, data_ptr, end_addr - addr, &inst);
+      parallel_for (round.size (), this->jobs,
+                    [&] (size_t index, unsigned int worker)
+                    {
+                      this->decode_block (round[index], &disasms[worker],
+                                          &blocks[index]);
+                    });
 
-    if (inst.get_target () != 0)
-      {
-        switch (inst.get_type ())
-          {
-          case Instruction::CALL:
-            this->set_label (Label (inst.get_target (), Label::FUNCTION));
-            this->add_code_trace_address (inst.get_target ());
-            break;
+      for (n = 0; n < round.size (); n++)
+        this->merge_block (round[n], blocks[n]);
+    }
+}
 
-          case Instruction::COND_JUMP:
-          case Instruction::JUMP:
-            this->set_label (Label (inst.get_target (), Label::JUMP));
-            this->add_code_trace_address (inst.get_target ());
-            break;
+void
+Analyser::trace_code_at_address (uint32_t start_addr)
+{
+  Region::Type type;
 
-          default:
-            break;
-          }
-      }
+  if (!this->start_trace (start_addr, &type))
+    return;
 
-    addr += inst.get_size();
+  this->continue_trace (start_addr, type);
+  this->trace_log.edit ()->end_block ();
+}
 
-    switch (inst.get_type ())
-      {
-      case Instruction::JUMP:
-      case Instruction::RET:
-        goto end;
+/** Checks whether tracing can start at given address.
+ *
+ * Returns type of the region the tracing starts in.
+ */
+bool
+Analyser::start_trace (uint32_t start_addr, Region::Type *type)
+{
+  if (!this->shadow.contains_address (start_addr))
+    {
+      std::cerr << "Warning: Tried to trace code at an unmapped address: 0x"
+                << std::hex << start_addr << ".\n";
+      return false;
+    }
 
-      default:
-        break;
-      }
-  }
+  *type = this->shadow.get_type (start_addr);
+  if (*type == Region::CODE) /* already traced */
+    {
+      if (!this->shadow.is_instruction_start (start_addr))
+        std::cerr << "Warning: Tried to trace code in the middle of "
+                     "an instruction at 0x" << std::hex << start_addr << ".\n";
+      return false;
+    }
 
-end:
-  this->insert_region
-    (reg, Region (start_addr, addr - start_addr, Region::CODE));
+  this->shadow.set_flag (start_addr, ShadowMap::TRACED);
+  this->regions_dirty = true;
+  this->cfg_dirty = true;
+  this->data_types_dirty = true;
+  this->xrefs_dirty = true;
+  this->trace_log.edit ()->begin_block (start_addr);
+  this->schedule (TASK_RELOCS);
+  return true;
 }
 
-Region *
-Analyser::get_previous_region (const Region *reg)
+void
+Analyser::continue_trace (uint32_t addr, Region::Type type)
 {
-  return get_previous_value (&this->regions, reg->get_address ());
+  TracedInstruction ti;
+
+  while (this->decode_traced_instruction (addr, type, &this->disasm, &ti)
+         and this->apply_traced_instruction (&ti))
+    addr += ti.size;
 }
 
-Region *
-Analyser::get_region_at_address (uint32_t address)
+/** Decodes one instruction of a block traced within region of given type.
+ *
+ * Returns false if the address is outside of that region.
+ */
+bool
+Analyser::decode_traced_instruction (uint32_t addr, Region::Type type,
+                                     Disassembler *disasm,
+                                     TracedInstruction *ret) const
 {
-  Analyser::RegionMap::iterator itr;
+  const Image::Object *obj;
+  Instruction inst;
+  size_t length;
+
+  /* Tracing stops at the end of region it has started in */
+  length = this->shadow.get_run_length (addr, max_instruction_size);
+  if (length == 0 or this->shadow.get_type (addr) != type)
+    return false;
+
+  obj = this->image->get_object_at_address (addr);
+  disasm->disassemble (addr, obj->get_data_at (addr), length, &inst);
+
+  ret->address = addr;
+  ret->length  = length;
+  ret->size    = inst.get_size ();
+  ret->type    = inst.get_type ();
+  ret->target  = inst.get_target ();
+  return true;
+}
 
-  if (this->regions.empty ())
-    return NULL;
+/** Marks traced instruction and follows its target.
+ *
+ * Returns false if the instruction ends the block.
+ */
+bool
+Analyser::apply_traced_instruction (const TracedInstruction *ti)
+{
+  this->shadow.set_instruction (ti->address, ti->size);
+  this->trace_log.edit ()->extend_block (ti->address + ti->size);
 
-  itr = this->regions.lower_bound (address);
+  if (ti->type == Instruction::JUMP or ti->type == Instruction::COND_JUMP
+      or ti->type == Instruction::RET)
+    this->cfg.edit ()->add_branch (ti->address, ti->type, ti->target);
 
-  if (itr == this->regions.end ())
+  if (ti->target != 0)
     {
-      --itr;
-        
-      if (itr->second.contains_address (address))
-        return &itr->second;
-      else
-        return NULL;
+      switch (ti->type)
+        {
+        case Instruction::CALL:
+          this->set_label (Label (ti->target, Label::FUNCTION));
+          this->add_code_trace_address (ti->target);
+          this->xrefs.edit ()->add_code_ref (ti->address, ti->target,
+                                            XrefTable::CALL);
+          break;
+
+        case Instruction::COND_JUMP:
+        case Instruction::JUMP:
+          this->set_label (Label (ti->target, Label::JUMP));
+          this->add_code_trace_address (ti->target);
+          this->xrefs.edit ()->add_code_ref (ti->address, ti->target,
+                                            XrefTable::JUMP);
+          break;
+
+        default:
+          break;
+        }
     }
 
-  if (itr->first == address)
-    return &itr->second;
+  switch (ti->type)
+    {
+    case Instruction::JUMP:
+    case Instruction::RET:
+      return false;
 
-  if (itr == this->regions.begin ())
-    return NULL;
+    default:
+      return true;
+    }
+}
 
-  --itr;
+/* Decodes a block without modifying anything; used by tracing workers. */
+void
+Analyser::decode_block (uint32_t start_addr, Disassembler *disasm,
+                        TraceBlock *block) const
+{
+  TracedInstruction ti;
+  Region::Type type;
+  uint32_t addr;
 
-  if (!itr->second.contains_address (address))
-    return NULL;
+  block->clear ();
 
-  return &itr->second;
-}
+  if (!this->shadow.contains_address (start_addr))
+    return;
 
-Region *
-Analyser::get_region (uint32_t address)
-{
-  Analyser::RegionMap::iterator itr;
+  type = this->shadow.get_type (start_addr);
+  if (type == Region::CODE)
+    return;
 
-  itr = this->regions.find (address);
-  if (itr == this->regions.end ())
-    return NULL;
+  addr = start_addr;
+
+  while (this->decode_traced_instruction (addr, type, disasm, &ti))
+    {
+      block->push_back (ti);
 
-  return &itr->second;
+      if (ti.type == Instruction::JUMP or ti.type == Instruction::RET)
+        break;
+
+      addr += ti.size;
+    }
 }
 
+/** Applies block decoded by a worker, as if it was traced right now.
+ *
+ * Blocks merged earlier could only have turned some bytes into code,
+ * which may cut the block short. When that shortens the bytes given to
+ * the disassembler for an instruction, tracing goes on sequentially.
+ */
 void
-Analyser::insert_region (Region *parent, const Region &reg)
+Analyser::merge_block (uint32_t start_addr, const TraceBlock &block)
 {
-  assert (parent->contains_address (reg.get_address ()));
-  assert (parent->contains_address (reg.get_end_address () - 1));
+  const TracedInstruction *ti;
+  Region::Type type;
+  uint32_t addr;
+  size_t length;
+  size_t n;
+  bool done;
 
-  if (reg.get_end_address () != parent->get_end_address ())
+  if (!this->start_trace (start_addr, &type))
+    return;
+
+  addr = start_addr;
+  done = false;
+
+  for (n = 0; n < block.size () and !done; n++)
     {
-      this->add_region
-        (Region (reg.get_end_address (),
-                 parent->get_end_address () - reg.get_end_address (),
-                 parent->get_type ()));
+      ti = &block[n];
+
+      length = this->shadow.get_run_length (addr, max_instruction_size);
+      if (length == 0 or this->shadow.get_type (addr) != type)
+        done = true;
+      else if (length != ti->length)
+        break;
+      else if (!this->apply_traced_instruction (ti))
+        done = true;
+      else
+        addr += ti->size;
     }
 
-  if (reg.get_address () != parent->get_address ())
+  if (!done)
+    this->continue_trace (addr, type);
+
+  this->trace_log.edit ()->end_block ();
+}
+
+/** Commits vtables found among relocation targets.
+ *
+ * Runs of dwords which are zero or relocated are found beforehand for
+ * all targets; here they are only cut at the end of unknown bytes and
+ * have their entries queued, to be traced together afterwards.
+ */
+void
+Analyser::trace_vtables (void)
+{
+  const RelocTable::Target *target;
+  const uint8_t *data_ptr;
+  uint32_t addr;
+  size_t size;
+  size_t off;
+  size_t n;
+
+  for (n = 0; n < this->relocs->size (); n++)
     {
-      this->add_region (reg);
+      target = &this->relocs->at (n);
+
+      if (target->kind != RelocTable::VTABLE_RUN
+          or this->shadow.get_type (target->address) != Region::UNKNOWN)
+        continue;
+
+      size = this->shadow.get_run_length (target->address, target->run_size);
+      size &= ~(size_t) 3;
+      if (size == 0)
+        continue;
+
+      data_ptr = this->image->get_object_at_address (target->address)
+                 ->get_data_at (target->address);
 
-      parent->size = reg.get_address () - parent->get_address ();
+      for (off = 0; off < size; off += 4)
+        {
+          addr = read_le<uint32_t> (data_ptr + off);
+
+          if (addr != 0)
+            {
+              this->set_label (Label (addr, Label::FUNCTION));
+              this->trace_log.edit ()->add_root (addr, target->address,
+                                        target->address + size);
+              this->queue_code_trace (addr);
+            }
+        }
+
+      this->set_region (Region (target->address, size, Region::VTABLE));
+      this->set_label (Label (target->address, Label::VTABLE));
     }
-  else
-    *parent = reg;
+}
+
+void
+Analyser::schedule (Task task)
+{
+  this->pending_tasks |= 1u << task;
+}
 
-  this->check_merge_regions (reg.address);
+/* Labels relocation target in data, or at an unlabelled instruction. */
+void
+Analyser::label_reloc (uint32_t addr, Region::Type type)
+{
+  if (type == Region::DATA)
+    this->set_label (Label (addr, Label::DATA));
+  else if (type == Region::CODE and this->shadow.is_instruction_start (addr)
+           and this->get_label (addr) == NULL)
+    this->set_label (Label (addr, Label::JUMP));
 }
 
+/** Labels relocation targets which are no longer of unknown type.
+ *
+ * Targets are kept in address order; the ones still unknown stay for
+ * guessing. Guessed targets where tracing really started are reported
+ * as guesses, the ones covered by code traced from elsewhere are left
+ * like any other target in the middle of a function.
+ */
 void
-Analyser::check_merge_regions (uint32_t addr)
+Analyser::label_relocs (void)
 {
-  Region *reg;
-  Region *prev;
-  Region *next;
+  Region::Type type;
+  uint32_t addr;
+  std::vector<uint32_t> *targets;
+  uint8_t flags;
+  size_t kept;
+  size_t n;
 
-  reg = this->get_region (addr);
-  prev = this->get_previous_region (reg);
-  next = this->get_next_region (reg);
+  PUSH_IOS_FLAGS (&std::cerr);
+  std::cerr.setf (ios::hex, ios::basefield);
+  std::cerr.setf (ios::showbase);
 
-  if (prev != NULL and prev->get_type () == reg->get_type ()
-      and prev->get_end_address () == reg->get_address ())
+  for (n = 0; n < this->reloc_guesses->size (); n++)
     {
-      prev->size += reg->size;
-      this->regions.erase (addr);
-      reg = prev;
+      addr = (*this->reloc_guesses)[n];
+      flags = this->shadow.get_flags (addr);
+
+      if ((flags & ShadowMap::GUESSED) != 0
+          and (flags & ShadowMap::TRACED) != 0)
+        {
+          std::cerr << "Guessing that " << addr << " is a function.\n";
+          this->guess_count++;
+          this->set_label (Label (addr, Label::FUNCTION));
+        }
+      else
+        this->label_reloc (addr, this->shadow.get_type (addr));
     }
 
-  if (next != NULL and reg->get_type () == next->get_type ()
-      and reg->get_end_address () == next->get_address ())
+  this->reloc_guesses = CowPtr<std::vector<uint32_t> > ();
+
+  targets = this->reloc_targets.edit ();
+  kept = 0;
+
+  for (n = 0; n < targets->size (); n++)
     {
-      reg->size += next->size;
-      this->regions.erase (next->get_address ());
+      addr = (*targets)[n];
+      type = this->shadow.get_type (addr);
+
+      if (type == Region::UNKNOWN)
+        {
+          (*targets)[kept++] = addr;
+          continue;
+        }
+
+      this->label_reloc (addr, type);
     }
+
+  targets->resize (kept);
+
+  if (kept > 0)
+    this->schedule (TASK_GUESS);
 }
 
-void
-Analyser::trace_vtables (void)
+/** Checks if code at a guessed function start looks valid.
+ *
+ * The code is decoded into a scratch list, following jumps but not
+ * calls, without modifying the analysis. Returns NULL if nothing wrong
+ * was found, or the reason to reject the guess. The span receives
+ * the range of addresses the decision depends on.
+ */
+const char *
+Analyser::check_guess (uint32_t start_addr, TraceLog::Range *span)
 {
-  const LEFM *fixups;
-  LEFM::const_iterator itr;
+  typedef std::pair<uint32_t, uint32_t> Range;
+  std::vector<uint32_t> pending;
+  std::vector<uint32_t> targets;
+  std::vector<uint32_t> starts;
+  std::vector<Range> decoded;
+  std::vector<uint32_t>::iterator itr;
   const Image::Object *obj;
-  const uint8_t *data_ptr;
-  Region *reg;
-  size_t off;
-  size_t size;
-  size_t count;
-  size_t n;
+  Region::Type type;
+  Instruction inst;
   uint32_t addr;
-  const uint32_t *aptr;
+  uint32_t target;
+  size_t length;
+  size_t n;
 
-  PUSH_IOS_FLAGS (&std::cerr);
-  std::cerr.setf (ios::hex, ios::basefield);
-  std::cerr.setf (ios::showbase);
+  auto touch = [span] (uint32_t start, uint32_t end)
+               {
+                 span->start = std::min (span->start, start);
+                 span->end   = std::max (span->end, end);
+               };
 
-  for (n = 0; n < this->le->get_object_count (); n++)
+  span->start = start_addr;
+  span->end   = start_addr + 1;
+  pending.push_back (start_addr);
+
+  while (!pending.empty () and decoded.size () < max_guess_instructions)
     {
-      fixups = this->le->get_fixups_for_object (n);
+      addr = pending.back ();
+      pending.pop_back ();
 
-      for (itr = fixups->begin (); itr != fixups->end (); ++itr)
+      for (;;)
         {
-          reg = this->get_region_at_address (itr->second.address);
-          if (reg == NULL)
+          touch (addr, addr + 1);
+
+          if (!this->shadow.contains_address (addr))
+            return "runs out of the objects";
+
+          type = this->shadow.get_type (addr);
+          if (type == Region::CODE)
             {
-              std::cerr << "Warning: Reloc pointing to unmapped memory at "
-                        << itr->second.address << ".\n";
-              continue;
+              if (!this->shadow.is_instruction_start (addr))
+                return "overlaps traced code";
+              break;
             }
+          else if (type != Region::UNKNOWN)
+            return "runs into data";
 
-          if (reg->get_type () != Region::UNKNOWN)
-            continue;
+          itr = std::lower_bound (starts.begin (), starts.end (), addr);
+          if (itr != starts.end () and *itr == addr)
+            break;
 
-          obj = this->image->get_object_at_address (reg->get_address ());
-          if (!obj->is_executable ())
-            continue;
-          size = reg->get_end_address () - itr->second.address;
-          aptr = get_next_value (this->le->get_fixup_addresses (),
-                                 itr->second.address);
-          if (aptr != NULL)
-            size = std::min<size_t> (size, *aptr - itr->second.address);
+          starts.insert (itr, addr);
 
-          data_ptr = obj->get_data_at (itr->second.address);
-          count = 0;
-          off = 0;
+          length = this->shadow.get_run_length (addr, max_instruction_size);
+          obj = this->image->get_object_at_address (addr);
+          this->disasm.disassemble (addr, obj->get_data_at (addr), length,
+                                    &inst);
+          touch (addr, addr + length + 1);
 
-          while (off + 4 <= size)
+          if (inst.get_size () == 0 or inst.get_string () == "(bad)")
             {
-              addr = read_le<uint32_t> (data_ptr + off);
+              /* It may be valid, but cut short by traced code after it */
+              if (length < max_instruction_size
+                  and this->shadow.get_type (addr + length) == Region::CODE)
+                return "overlaps traced code";
+
+              return "has an invalid instruction";
+            }
 
-              if (addr == 0
-                  or fixups->find (itr->second.address + off
-                                   - obj->get_base_address ())
-                     != fixups->end ())
+          decoded.push_back (Range (addr, addr + inst.get_size ()));
+          target = inst.get_target ();
+
+          if (target != 0 and inst.get_type () != Instruction::RET)
+            {
+              touch (target, target + 1);
+
+              if (!this->shadow.contains_address (target))
+                return "has a target out of the objects";
+
+              type = this->shadow.get_type (target);
+              if (type == Region::CODE
+                  and !this->shadow.is_instruction_start (target))
+                return "has a target in the middle of an instruction";
+              else if (type != Region::CODE and type != Region::UNKNOWN)
+                return "has a target in data";
+
+              itr = std::lower_bound (targets.begin (), targets.end (),
+                                      target);
+              if (type == Region::UNKNOWN
+                  and (itr == targets.end () or *itr != target))
                 {
-                  count++;
+                  targets.insert (itr, target);
 
-                  if (addr != 0)
-                    {
-                      this->set_label (Label (addr, Label::FUNCTION));
-                      this->add_code_trace_address (addr);
-                    }
+                  if (inst.get_type () != Instruction::CALL)
+                    pending.push_back (target);
                 }
-              else
-                break;
-
-              off += 4;
             }
 
-          if (count > 0)
-            {
-              this->insert_region (reg, Region (itr->second.address,
-                                                4 * count, Region::VTABLE));
-              this->set_label (Label (itr->second.address, Label::VTABLE));
-              this->trace_code ();
-            }
+          if (inst.get_type () == Instruction::JUMP
+              or inst.get_type () == Instruction::RET)
+            break;
+
+          addr += inst.get_size ();
         }
     }
+
+  /* The scratch code must not overlap itself, nor be jumped into */
+  std::sort (decoded.begin (), decoded.end ());
+
+  for (n = 1; n < decoded.size (); n++)
+    {
+      if (decoded[n].first < decoded[n - 1].second)
+        return "overlaps itself";
+    }
+
+  for (n = 0; n < targets.size (); n++)
+    {
+      std::vector<Range>::const_iterator ditr;
+
+      ditr = std::upper_bound (decoded.begin (), decoded.end (),
+                               Range (targets[n], UINT32_MAX));
+      if (ditr != decoded.begin () and (ditr - 1)->first != targets[n]
+          and (ditr - 1)->second > targets[n])
+        return "has a target in the middle of an instruction";
+    }
+
+  return NULL;
 }
 
+/** Turns data made of rejected guesses back into unknown bytes.
+ *
+ * A guess may have been rejected because of code which is gone after
+ * an update, so the relocation targets of guesses depending on cleared
+ * ranges are guessed again.
+ */
 void
-Analyser::trace_remaining_relocs (void)
+Analyser::forget_rejected_guesses (const std::vector<TraceLog::Range> &cleared)
 {
-  const LEFM *fixups;
-  LEFM::const_iterator itr;
-  Region *reg;
+  std::vector<TraceLog::Range>::const_iterator itr;
+  std::vector<RejectedGuess> *guesses;
+  std::vector<uint32_t> *targets;
+  const RejectedGuess *guess;
+  const Label *label;
+  uint32_t start;
+  uint32_t end;
+  size_t kept;
   size_t n;
-  size_t guess_count = 0;
+  size_t i;
+
+  guesses = this->rejected_guesses.edit ();
+  targets = this->reloc_targets.edit ();
+  kept = 0;
+
+  for (n = 0; n < guesses->size (); n++)
+    {
+      guess = &(*guesses)[n];
+
+      /* Cleared ranges are sorted and disjoint */
+      itr = std::upper_bound (cleared.begin (), cleared.end (),
+                              guess->span.start,
+                              [] (uint32_t addr, const TraceLog::Range &range)
+                              {
+                                return addr < range.end;
+                              });
+      if (itr == cleared.end () or itr->start >= guess->span.end)
+        {
+          (*guesses)[kept++] = *guess;
+          continue;
+        }
+
+      start = guess->data.start;
+      end   = guess->data.end;
+      this->shadow.reset (start, end - start);
+      this->apply_forced_regions (guess->data);
+
+      for (i = this->relocs->lower_bound (start);
+           i < this->relocs->size () and this->relocs->at (i).address < end;
+           i++)
+        {
+          if (this->relocs->at (i).kind == RelocTable::UNMAPPED)
+            continue;
+
+          label = this->labels.find (this->relocs->at (i).address);
+          if (label != NULL and !label->has_name ()
+              and label->get_type () == Label::DATA)
+            this->labels.erase (label->get_address ());
+
+          targets->push_back (this->relocs->at (i).address);
+        }
+    }
+
+  guesses->resize (kept);
+}
+
+/** Guesses that lowest relocation targets in runs of unknown bytes are
+ * functions, and queues them for tracing.
+ *
+ * Guesses which do not look like valid code are rejected; bytes from
+ * the target up to the next one are taken to be data instead.
+ */
+void
+Analyser::guess_relocs (void)
+{
   const Label *label;
+  const char *reason;
+  std::vector<uint32_t> *targets;
+  RejectedGuess guess;
+  uint32_t addr;
+  uint32_t end;
+  size_t kept;
+  size_t n;
 
   PUSH_IOS_FLAGS (&std::cerr);
   std::cerr.setf (ios::hex, ios::basefield);
   std::cerr.setf (ios::showbase);
 
-  for (n = 0; n < this->image->get_object_count (); n++)
+  targets = this->reloc_targets.edit ();
+  kept = 0;
+  end = 0;
+
+  for (n = 0; n < targets->size (); n++)
     {
-      fixups = this->le->get_fixups_for_object (n);
+      addr = (*targets)[n];
 
-      for (itr = fixups->begin (); itr != fixups->end (); ++itr)
+      if (n > 0 and addr < end)
         {
-          reg = this->get_region_at_address (itr->second.address);
-          if (reg == NULL
-              or (reg->get_type () != Region::UNKNOWN
-                  and reg->get_type () != Region::DATA))
-            continue;
+          (*targets)[kept++] = addr;
+          continue;
+        }
+
+      end = addr + this->shadow.get_run_length (addr, SIZE_MAX);
 
-          if (reg->get_type () == Region::UNKNOWN)
+      label = this->get_label (addr);
+      if (label == NULL
+          or (label->get_type () != Label::FUNCTION
+              and label->get_type () != Label::JUMP))
+        {
+          reason = this->check_guess (addr, &guess.span);
+          if (reason != NULL)
             {
-              label = this->get_label (itr->second.address);
+              std::cerr << "Not guessing that " << addr
+                        << " is a function, it " << reason << ".\n";
 
-              if (label == NULL
-                  or (label->get_type () != Label::FUNCTION
-                      and label->get_type () != Label::JUMP))
-                {
-                  std::cerr << "Guessing that " << itr->second.address
-                            << " is a function.\n";
-                  guess_count++;
-                  this->set_label (Label (itr->second.address,
-                                          Label::FUNCTION));
-                }
+              guess.data.start = addr;
+              guess.data.end   = end;
+              if (n + 1 < targets->size ())
+                guess.data.end = std::min (end, (*targets)[n + 1]);
 
-              this->add_code_trace_address (itr->second.address);
-              this->trace_code ();
-            }
-          else
-            {
-              this->set_label (Label (itr->second.address,
-                                      Label::DATA));
+              guess.span.start = std::min (guess.span.start, guess.data.start);
+              guess.span.end   = std::max (guess.span.end, guess.data.end);
+              this->rejected_guesses.edit ()->push_back (guess);
+
+              this->set_region (Region (addr, guess.data.end - addr,
+                                        Region::DATA));
+              this->reloc_guesses.edit ()->push_back (addr);
+              continue;
             }
+
+          this->shadow.set_flag (addr, ShadowMap::GUESSED);
         }
+
+      this->reloc_guesses.edit ()->push_back (addr);
+      this->trace_log.edit ()->add_root (addr, addr, addr + 1);
+      this->queue_code_trace (addr);
     }
 
-  std::cerr.setf (ios::dec, ios::basefield);
-  std::cerr.unsetf (ios::showbase);
-  std::cerr << guess_count << " guess(es) to investigate.\n";
+  targets->resize (kept);
+  this->schedule (TASK_RELOCS);
 }
 
 Analyser::Analyser (void)
@@ -422,6 +812,13 @@ Analyser::Analyser (void)
   this->le    = NULL;
   this->image = NULL;
   this->known_type = KnownFile::NOT_KNOWN;
+  this->regions_dirty = false;
+  this->cfg_dirty = false;
+  this->xrefs_dirty = false;
+  this->data_types_dirty = false;
+  this->jobs = 1;
+  this->pending_tasks = 0;
+  this->guess_count = 0;
 }
 
 Analyser::Analyser (const Analyser &other)
@@ -435,43 +832,154 @@ Analyser::Analyser (LinearExecutable *le, Image *img)
   this->image = img;
   this->add_initial_regions ();
   this->known_type = KnownFile::NOT_KNOWN;
+  this->jobs = 1;
+  this->pending_tasks = 0;
+  this->guess_count = 0;
 }
 
+/** Copies whole state of the analysis.
+ *
+ * The shadow map, labels, trace queue, regions, relocations and their
+ * pending targets and guesses, forced regions and logs of tracing are
+ * shared with the copy until either side modifies them, so a copy taken
+ * as a checkpoint is cheap, and so is assigning it back to roll the
+ * analysis back.
+ */
 Analyser &
 Analyser::operator= (const Analyser &other)
 {
+  this->regions       = other.regions;
+  this->regions_dirty = other.regions_dirty;
+  this->shadow = other.shadow;
+  this->labels = other.labels;
+  this->code_trace_queue = other.code_trace_queue;
   this->le     = other.le;
   this->image  = other.image;
   this->disasm = other.disasm;
   this->known_type = other.known_type;
-  this->add_initial_regions ();
+  this->jobs   = other.jobs;
+  this->pending_tasks  = other.pending_tasks;
+  this->relocs         = other.relocs;
+  this->reloc_targets  = other.reloc_targets;
+  this->reloc_guesses  = other.reloc_guesses;
+  this->guess_count    = other.guess_count;
+  this->forced_regions = other.forced_regions;
+  this->rejected_guesses = other.rejected_guesses;
+  this->trace_log   = other.trace_log;
+  this->cfg         = other.cfg;
+  this->cfg_dirty   = other.cfg_dirty;
+  this->xrefs       = other.xrefs;
+  this->xrefs_dirty = other.xrefs_dirty;
+  this->data_types       = other.data_types;
+  this->data_types_dirty = other.data_types_dirty;
   return *this;
 }
 
-Label *
-Analyser::get_next_label (const Label *lab)
+const Label *
+Analyser::get_next_label (const Label *lab) const
+{
+  return this->labels.find_next (lab->get_address ());
+}
+
+const Label *
+Analyser::get_next_label (uint32_t addr) const
 {
-  return get_next_value (&this->labels, lab->get_address ());
+  return this->labels.find_next (addr);
 }
 
-Label *
-Analyser::get_next_label (uint32_t addr)
+const Region *
+Analyser::get_next_region (const Region *reg) const
 {
-  return get_next_value (&this->labels, addr);
+  size_t index;
+
+  index = this->regions->index_of (reg) + 1;
+  if (index >= this->regions->size ())
+    return NULL;
+
+  return &this->regions->at (index);
 }
 
-Region *
-Analyser::get_next_region (const Region *reg)
+void
+Analyser::set_region (const Region &reg)
 {
-  return get_next_value (&this->regions, reg->get_address ());
+  this->shadow.set_type (reg.get_address (), reg.get_size (),
+                         reg.get_type ());
+  this->regions_dirty = true;
+  this->cfg_dirty = true;
+  this->data_types_dirty = true;
+  this->xrefs_dirty = true;
+  this->schedule (TASK_RELOCS);
 }
 
+/** Forces type of a region, over whatever analysis finds there.
+ *
+ * When the code was already analysed, call update () afterwards.
+ */
 void
 Analyser::insert_region (const Region &reg)
 {
-  Region *parent;
-  parent = this->get_region_at_address (reg.get_address ());
-  this->insert_region (parent, reg);
+  this->forced_regions.edit ()->push_back (reg);
+  this->set_region (reg);
+  this->trace_log.edit ()->invalidate (reg.get_address (),
+                              reg.get_address () + reg.get_size ());
+}
+
+/** Removes region forced before at given address.
+ *
+ * When the code was already analysed, call update () afterwards.
+ */
+void
+Analyser::remove_region (uint32_t addr)
+{
+  std::vector<Region> *forced;
+  const Region *reg;
+  TraceLog::Range range;
+  size_t n;
+
+  for (n = 0; n < this->forced_regions->size (); n++)
+    {
+      if ((*this->forced_regions)[n].get_address () == addr)
+        break;
+    }
+
+  if (n == this->forced_regions->size ())
+    return;
+
+  reg = &(*this->forced_regions)[n];
+  range.start = reg->get_address ();
+  range.end   = reg->get_address () + reg->get_size ();
+
+  forced = this->forced_regions.edit ();
+  forced->erase (forced->begin () + n);
+
+  this->shadow.reset (range.start, range.end - range.start);
+  this->apply_forced_regions (range);
+  this->regions_dirty = true;
+  this->cfg_dirty = true;
+  this->data_types_dirty = true;
+  this->xrefs_dirty = true;
+  this->schedule (TASK_RELOCS);
+  this->trace_log.edit ()->invalidate (range.start, range.end);
+}
+
+/* Sets types of forced regions again within given range. */
+void
+Analyser::apply_forced_regions (const TraceLog::Range &range)
+{
+  uint32_t start;
+  uint32_t end;
+  size_t n;
+
+  for (n = 0; n < this->forced_regions->size (); n++)
+    {
+      const Region *reg = &(*this->forced_regions)[n];
+
+      start = std::max<uint32_t> (reg->get_address (), range.start);
+      end = std::min<uint32_t> (reg->get_address () + reg->get_size (),
+                                range.end);
+      if (start < end)
+        this->shadow.set_type (start, end - start, reg->get_type ());
+    }
 }
 
 void
@@ -483,35 +991,416 @@ Analyser::set_label (const Label &lab)
   if (label != NULL)
     {
       if (label->get_type () == Label::FUNCTION
-          or !label->get_name ().empty ())
+          or label->has_name ())
         return;
     }
 
-  this->labels[lab.get_address ()] = lab;
+  this->labels.set (lab);
+  this->cfg_dirty = true;
+  this->data_types_dirty = true;
 }
 
+/** Sets a label, tracing code at it if it is a function or a jump.
+ *
+ * When the code was already analysed, call update () afterwards.
+ */
+void
+Analyser::add_label (const Label &lab)
+{
+  this->set_label (lab);
+
+  if (lab.get_type () == Label::FUNCTION or lab.get_type () == Label::JUMP)
+    this->add_code_trace_address (lab.get_address ());
+}
+
+/** Removes a label, and the code traced only because of it.
+ *
+ * When the code was already analysed, call update () afterwards.
+ */
 void
 Analyser::remove_label (uint32_t addr)
 {
+  std::vector<uint32_t> *targets;
+  std::vector<uint32_t>::iterator itr;
+  size_t n;
+
   this->labels.erase (addr);
+  this->trace_log.edit ()->remove_root (addr);
+  this->cfg_dirty = true;
+  this->data_types_dirty = true;
+
+  /* Relocation targets are labelled again, like after tracing */
+  n = this->relocs->lower_bound (addr);
+  if (n < this->relocs->size () and this->relocs->at (n).address == addr
+      and this->relocs->at (n).kind != RelocTable::UNMAPPED)
+    {
+      targets = this->reloc_targets.edit ();
+      itr = std::lower_bound (targets->begin (), targets->end (), addr);
+      if (itr == targets->end () or *itr != addr)
+        targets->insert (itr, addr);
+
+      this->schedule (TASK_RELOCS);
+    }
 }
 
 void
 Analyser::run (void)
 {
+  std::vector<uint32_t> *targets;
+  size_t n;
+
+  this->relocs.edit ()->build (this->le, this->image, this->jobs);
+  this->reloc_targets = CowPtr<std::vector<uint32_t> > ();
+  targets = this->reloc_targets.edit ();
+
+  {
+    PUSH_IOS_FLAGS (&std::cerr);
+    std::cerr.setf (ios::hex, ios::basefield);
+    std::cerr.setf (ios::showbase);
+
+    for (n = 0; n < this->relocs->size (); n++)
+      {
+        if (this->relocs->at (n).kind != RelocTable::UNMAPPED)
+          targets->push_back (this->relocs->at (n).address);
+        else
+          std::cerr << "Warning: Reloc pointing to unmapped memory at "
+                    << this->relocs->at (n).address << ".\n";
+      }
+  }
+
   this->add_eip_to_trace_queue ();
+  this->schedule (TASK_VTABLES);
+  this->schedule (TASK_RELOCS);
+
   std::cerr << "Tracing code directly accessible from the entry point...\n";
-  this->trace_code ();
-  std::cerr << "Tracing text relocs for vtables...\n";
-  this->trace_vtables ();
-  std::cerr << "Tracing remaining relocs for functions and data...\n";
-  this->trace_remaining_relocs ();
+  this->run_tasks ();
+  std::cerr << this->guess_count << " guess(es) to investigate.\n";
+}
+
+/** Analyses again everything affected by edits made after run ().
+ *
+ * Code traced from the edited ranges, or reachable only through such
+ * code or through removed labels, is dropped together with its labels,
+ * then traced again from the addresses which still lead to it.
+ */
+void
+Analyser::update (void)
+{
+  std::vector<TraceLog::Range> cleared;
+  std::vector<uint32_t> wanted;
+  std::vector<uint32_t> stale;
+  const TraceLog::Range *range;
+  std::vector<uint32_t> *targets;
+  const Label *label;
+  size_t n;
+  size_t i;
+
+  if (this->trace_log->needs_sweep ())
+    {
+      this->trace_log.edit ()->sweep (&cleared, &wanted, &stale);
+      targets = this->reloc_targets.edit ();
+
+      for (n = 0; n < cleared.size (); n++)
+        {
+          range = &cleared[n];
+          this->shadow.reset (range->start, range->end - range->start);
+          this->apply_forced_regions (*range);
+
+          /* Labels put there by tracing which nothing leads to any more */
+          label = this->labels.find (range->start);
+          if (label == NULL)
+            label = this->labels.find_next (range->start);
+
+          while (label != NULL and label->get_address () < range->end)
+            {
+              if (!std::binary_search (wanted.begin (), wanted.end (),
+                                       label->get_address ()))
+                stale.push_back (label->get_address ());
+
+              label = this->labels.find_next (label->get_address ());
+            }
+
+          for (i = this->relocs->lower_bound (range->start);
+               i < this->relocs->size ()
+               and this->relocs->at (i).address < range->end; i++)
+            {
+              if (this->relocs->at (i).kind != RelocTable::UNMAPPED)
+                targets->push_back (this->relocs->at (i).address);
+            }
+        }
+
+      this->forget_rejected_guesses (cleared);
+
+      for (n = 0; n < stale.size (); n++)
+        {
+          label = this->labels.find (stale[n]);
+
+          if (label != NULL and !label->has_name ()
+              and (label->get_type () == Label::FUNCTION
+                   or label->get_type () == Label::JUMP))
+            {
+              this->labels.erase (stale[n]);
+
+              i = this->relocs->lower_bound (stale[n]);
+              if (i < this->relocs->size ()
+                  and this->relocs->at (i).address == stale[n])
+                targets->push_back (stale[n]);
+            }
+        }
+
+      std::sort (targets->begin (), targets->end ());
+      targets->erase (std::unique (targets->begin (), targets->end ()),
+                      targets->end ());
+
+      /* Both are sorted, cleared ranges being disjoint */
+      for (n = 0, i = 0; n < wanted.size (); n++)
+        {
+          while (i < cleared.size () and cleared[i].end <= wanted[n])
+            i++;
+
+          if (i < cleared.size () and cleared[i].start <= wanted[n])
+            this->queue_code_trace (wanted[n]);
+        }
+
+      this->regions_dirty = true;
+      this->cfg_dirty = true;
+      this->data_types_dirty = true;
+      this->xrefs_dirty = true;
+      this->schedule (TASK_VTABLES);
+      this->schedule (TASK_RELOCS);
+    }
+
+  this->run_tasks ();
+}
+
+/* Runs scheduled tasks until none is left. */
+void
+Analyser::run_tasks (void)
+{
+  unsigned int task;
+  bool guessing = false;
+
+  /* Every task schedules the ones which may find something new after it */
+  while (this->pending_tasks != 0)
+    {
+      for (task = 0; (this->pending_tasks & (1u << task)) == 0; task++)
+        ;
+
+      this->pending_tasks &= ~(1u << task);
+
+      switch (task)
+        {
+        case TASK_TRACE:
+          this->trace_code ();
+          break;
+
+        case TASK_VTABLES:
+          std::cerr << "Tracing text relocs for vtables...\n";
+          this->trace_vtables ();
+          break;
+
+        case TASK_RELOCS:
+          this->label_relocs ();
+          break;
+
+        case TASK_GUESS:
+          if (!guessing)
+            std::cerr << "Tracing remaining relocs for functions and data...\n";
+          guessing = true;
+          this->guess_relocs ();
+          break;
+        }
+    }
+}
+
+void
+Analyser::set_trace_order (TraceQueue::Order order)
+{
+  this->code_trace_queue.set_order (order);
+}
+
+void
+Analyser::set_jobs (unsigned int jobs)
+{
+  this->jobs = std::max (jobs, 1u);
+}
+
+void
+Analyser::save_labels (DatabaseWriter *db) const
+{
+  const Label *lab;
+  size_t n;
+
+  db->put_u32 (this->labels.size ());
+
+  for (n = 0; n < this->labels.size (); n++)
+    {
+      lab = &this->labels.get_sorted (n);
+      db->put_u32 (lab->get_address ());
+      db->put_u8 (lab->get_type ());
+      db->put_string (lab->get_name ());
+    }
+}
+
+/** Returns hash of everything set up before the analysis.
+ *
+ * This covers the trace order, and the regions and labels given
+ * by KnownFile, so together with the input it identifies the result.
+ */
+uint64_t
+Analyser::get_config_hash (void) const
+{
+  DatabaseWriter db;
+  const std::vector<uint8_t> *data;
+  size_t n;
+
+  db.put_u8 (this->code_trace_queue.get_order ());
+  db.put_u8 (this->known_type);
+  db.put_u32 (this->forced_regions->size ());
+
+  for (n = 0; n < this->forced_regions->size (); n++)
+    {
+      db.put_u32 ((*this->forced_regions)[n].get_address ());
+      db.put_u32 ((*this->forced_regions)[n].get_size ());
+      db.put_u8 ((*this->forced_regions)[n].get_type ());
+    }
+
+  this->save_labels (&db);
+
+  data = db.get_data ();
+  return fnv1a_hash (data->data (), data->size ());
+}
+
+/** Writes the state needed to print the finished analysis.
+ */
+void
+Analyser::save (DatabaseWriter *db) const
+{
+  db->put_u8 (this->known_type);
+  this->shadow.save (db);
+  this->save_labels (db);
+  this->xrefs->save (db);
+  this->cfg->save (db);
+}
+
+/** Replaces the analysis with one written by save ().
+ *
+ * Regions and everything derived from them are built again on request.
+ * Relocations and logs of tracing are not stored, so the loaded analysis
+ * can be printed, but not updated.
+ */
+void
+Analyser::load (DatabaseReader *db)
+{
+  uint32_t count;
+  uint32_t addr;
+  Label::Type type;
+  std::string name;
+
+  this->known_type = (KnownFile::Type) db->get_u8 ();
+  this->shadow.load (db);
+
+  this->labels.clear ();
+
+  for (count = db->get_u32 (); count > 0; count--)
+    {
+      addr = db->get_u32 ();
+      type = (Label::Type) db->get_u8 ();
+      name = db->get_string ();
+      this->labels.set (Label (addr, type, name));
+    }
+
+  this->xrefs.edit ()->load (db);
+  this->cfg.edit ()->load (db);
+
+  this->code_trace_queue.clear ();
+  this->pending_tasks = 0;
+  this->regions_dirty = true;
+  this->cfg_dirty = true;
+  this->xrefs_dirty = true;
+  this->data_types_dirty = true;
 }
 
 const Analyser::RegionMap *
 Analyser::get_regions (void) const
 {
-  return &this->regions;
+  if (this->regions_dirty)
+    {
+      /* Built from scratch, leaving a table shared with a copy to it */
+      this->regions = CowPtr<RegionMap> ();
+      this->shadow.build_regions (this->regions.edit ());
+      this->regions_dirty = false;
+    }
+
+  return this->regions.get ();
+}
+
+/** Returns graph of the code traced so far.
+ *
+ * It is built again when requested after the analysis has changed.
+ */
+const ControlFlowGraph *
+Analyser::get_cfg (void) const
+{
+  if (this->cfg_dirty)
+    {
+      this->cfg.edit ()->build (&this->shadow, this->get_regions (),
+                                &this->labels);
+      this->cfg_dirty = false;
+    }
+
+  return this->cfg.get ();
+}
+
+/** Returns references between code and data found so far.
+ *
+ * The index is built again when requested after the analysis has changed.
+ */
+const XrefTable *
+Analyser::get_xrefs (void) const
+{
+  if (this->xrefs_dirty)
+    {
+      this->xrefs.edit ()->build (this->le, &this->shadow);
+      this->xrefs_dirty = false;
+    }
+
+  return this->xrefs.get ();
+}
+
+/** Returns typed sub-regions of the data found so far.
+ *
+ * The data are typed again when requested after the analysis has changed.
+ */
+const DataTypeTable *
+Analyser::get_data_types (void) const
+{
+  if (this->data_types_dirty)
+    {
+      this->data_types.edit ()->build (this->le, this->image,
+                                       this->get_regions (), &this->labels);
+      this->data_types_dirty = false;
+    }
+
+  return this->data_types.get ();
+}
+
+/** Builds the regions, typed data and label order ahead of their use.
+ *
+ * These are otherwise built on the first request, so this has to be
+ * called before the analysis is read from many threads at once.
+ */
+void
+Analyser::build_lookups (void) const
+{
+  this->get_data_types ();
+  this->labels.find_next (0);
+}
+
+const ShadowMap *
+Analyser::get_shadow (void) const
+{
+  return &this->shadow;
 }
 
 const Analyser::LabelMap *
@@ -523,11 +1412,5 @@ Analyser::get_labels (void) const
 const Label *
 Analyser::get_label (uint32_t addr) const
 {
-  Analyser::LabelMap::const_iterator itr;
-
-  itr = this->labels.find (addr);
-  if (itr == this->labels.end ())
-    return NULL;
-
-  return &itr->second;
+  return this->labels.find (addr);
 }
@@ -17,56 +17,117 @@
 #ifndef LEDISASM_ANALYSER_H
 #define LEDISASM_ANALYSER_H
 
-#include <deque>
 #include <inttypes.h>
-#include <map>
 #include <string>
+#include <vector>
 
+#include "cfg.hpp"
+#include "cow_ptr.hpp"
+#include "data_type_table.hpp"
 #include "disassembler.hpp"
 #include "known_file.hpp"
-
+#include "label_table.hpp"
+#include "region_table.hpp"
+#include "reloc_table.hpp"
+#include "shadow_map.hpp"
+#include "trace_log.hpp"
+#include "trace_queue.hpp"
+#include "xref_table.hpp"
+
+class DatabaseReader;
+class DatabaseWriter;
 class LinearExecutable;
 class Image;
-class Label;
-class Region;
 
 class Analyser
 {
 public:
-  typedef std::map<uint32_t, Region> RegionMap;
-  typedef std::map<uint32_t, Label>  LabelMap;
+  typedef RegionTable                RegionMap;
+  typedef LabelTable                 LabelMap;
+
+  /** Revision of the analysis; bump it whenever a change to the analyser
+   * can change its result, so that saved analyses are redone. */
+  static const uint32_t REVISION = 1;
 
 protected:
-  RegionMap            regions;
+  /** Analysis steps run by the engine; lower values go first. */
+  enum Task
+  {
+    TASK_TRACE,
+    TASK_VTABLES,
+    TASK_RELOCS,
+    TASK_GUESS
+  };
+
+  /** Data made of a guess which did not look like code. */
+  struct RejectedGuess
+  {
+    TraceLog::Range data;
+    TraceLog::Range span;  /* addresses the rejection depends on */
+  };
+
+protected:
+  mutable CowPtr<RegionMap> regions;
+  mutable bool         regions_dirty;
+  ShadowMap            shadow;
   LabelMap             labels;
-  std::deque<uint32_t> code_trace_queue;
+  TraceQueue           code_trace_queue;
   LinearExecutable    *le;
   Image               *image;
   Disassembler         disasm;
   KnownFile::Type      known_type;
+  unsigned int         jobs;
+  unsigned int         pending_tasks;
+  CowPtr<RelocTable>   relocs;
+  CowPtr<std::vector<uint32_t> > reloc_targets;
+  CowPtr<std::vector<uint32_t> > reloc_guesses;
+  size_t               guess_count;
+  CowPtr<std::vector<Region> > forced_regions;
+  CowPtr<std::vector<RejectedGuess> > rejected_guesses;
+  CowPtr<TraceLog>     trace_log;
+  mutable CowPtr<ControlFlowGraph> cfg;
+  mutable bool         cfg_dirty;
+  mutable CowPtr<XrefTable> xrefs;
+  mutable bool         xrefs_dirty;
+  mutable CowPtr<DataTypeTable> data_types;
+  mutable bool         data_types_dirty;
 
   friend class KnownFile;
 
 protected:
-  void  add_region (const Region &reg);
-
   void  add_initial_regions (void);
   void  add_eip_to_trace_queue (void);
   void  add_labels_to_trace_queue (void);
   void  add_code_trace_address (uint32_t addr);
+  void  queue_code_trace (uint32_t addr);
+
+  struct TracedInstruction;
+  typedef std::vector<TracedInstruction> TraceBlock;
 
   void  trace_code (void);
+  void  trace_code_parallel (void);
   void  trace_code_at_address (uint32_t start_addr);
-
-  Region * get_previous_region (const Region *reg);
-  Region * get_region_at_address (uint32_t address);
-  Region * get_region (uint32_t address);
-
-  void insert_region (Region *parent, const Region &reg);
-  void check_merge_regions (uint32_t addr);
-
-  void trace_vtables (void);
-  void trace_remaining_relocs (void);
+  bool  start_trace (uint32_t start_addr, Region::Type *type);
+  void  continue_trace (uint32_t addr, Region::Type type);
+  bool  decode_traced_instruction (uint32_t addr, Region::Type type,
+                                   Disassembler *disasm,
+                                   TracedInstruction *ret) const;
+  bool  apply_traced_instruction (const TracedInstruction *ti);
+  void  decode_block (uint32_t start_addr, Disassembler *disasm,
+                      TraceBlock *block) const;
+  void  merge_block (uint32_t start_addr, const TraceBlock &block);
+
+  void  schedule (Task task);
+  void  run_tasks (void);
+  void  set_region (const Region &reg);
+  void  apply_forced_regions (const TraceLog::Range &range);
+  void  trace_vtables (void);
+  void  label_reloc (uint32_t addr, Region::Type type);
+  void  label_relocs (void);
+  const char *check_guess (uint32_t start_addr, TraceLog::Range *span);
+  void  forget_rejected_guesses (const std::vector<TraceLog::Range> &cleared);
+  void  guess_relocs (void);
+  void  save_labels (DatabaseWriter *db) const;
 
 public:
   Analyser (void);
@@ -75,16 +136,30 @@ public:
 
   Analyser &operator= (const Analyser &other);
 
-  Label * get_next_label (const Label *lab);
-  Label * get_next_label (uint32_t addr);
-  Region *get_next_region (const Region *reg);
+  const Label * get_next_label (const Label *lab) const;
+  const Label * get_next_label (uint32_t addr) const;
+  const Region *get_next_region (const Region *reg) const;
 
   void insert_region (const Region &reg);
+  void remove_region (uint32_t addr);
   void set_label (const Label &lab);
+  void add_label (const Label &lab);
   void remove_label (uint32_t addr);
   void run (void);
+  void update (void);
+  void set_trace_order (TraceQueue::Order order);
+  void set_jobs (unsigned int jobs);
+
+  uint64_t get_config_hash (void) const;
+  void save (DatabaseWriter *db) const;
+  void load (DatabaseReader *db);
+  void build_lookups (void) const;
 
   const RegionMap *  get_regions (void) const;
+  const ControlFlowGraph *get_cfg (void) const;
+  const XrefTable *  get_xrefs (void) const;
+  const DataTypeTable *get_data_types (void) const;
+  const ShadowMap *  get_shadow (void) const;
   const LabelMap *  get_labels (void) const;
   const Label *  get_label (uint32_t addr) const;
 };
@@ -0,0 +1,145 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file byte_scan.cpp
+ *     Implementation of byte run scanners.
+ * @par Purpose:
+ *     Implements measuring of byte runs with SSE2 or AVX2 instructions
+ *     when the compiler targets them, and byte by byte otherwise.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#include "byte_scan.hpp"
+
+#if defined(__AVX2__)
+# include <immintrin.h>
+#elif defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
+#if defined(__SSE2__)
+
+/* Bit mask of printable bytes among 16; signed compares leave out bytes
+ * from 0x80 up, as these are negative. */
+static inline unsigned int
+printable_mask (__m128i bytes)
+{
+  __m128i ok;
+
+  ok = _mm_and_si128 (_mm_cmpgt_epi8 (bytes, _mm_set1_epi8 (0x1f)),
+                      _mm_cmplt_epi8 (bytes, _mm_set1_epi8 (0x7f)));
+  ok = _mm_or_si128 (ok, _mm_cmpeq_epi8 (bytes, _mm_set1_epi8 ('\t')));
+  ok = _mm_or_si128 (ok, _mm_cmpeq_epi8 (bytes, _mm_set1_epi8 ('\n')));
+  ok = _mm_or_si128 (ok, _mm_cmpeq_epi8 (bytes, _mm_set1_epi8 ('\r')));
+
+  return _mm_movemask_epi8 (ok);
+}
+
+#endif
+
+#if defined(__AVX2__)
+
+static inline unsigned int
+printable_mask_256 (__m256i bytes)
+{
+  __m256i ok;
+
+  ok = _mm256_and_si256 (_mm256_cmpgt_epi8 (bytes, _mm256_set1_epi8 (0x1f)),
+                         _mm256_cmpgt_epi8 (_mm256_set1_epi8 (0x7f), bytes));
+  ok = _mm256_or_si256 (ok, _mm256_cmpeq_epi8 (bytes,
+                                               _mm256_set1_epi8 ('\t')));
+  ok = _mm256_or_si256 (ok, _mm256_cmpeq_epi8 (bytes,
+                                               _mm256_set1_epi8 ('\n')));
+  ok = _mm256_or_si256 (ok, _mm256_cmpeq_epi8 (bytes,
+                                               _mm256_set1_epi8 ('\r')));
+
+  return _mm256_movemask_epi8 (ok);
+}
+
+#endif
+
+/** Returns number of zero bytes at start of given data.
+ */
+size_t
+count_zero_bytes (const uint8_t *data, size_t len)
+{
+  size_t x = 0;
+
+#if defined(__AVX2__)
+  unsigned int mask;
+
+  for (; x + 32 <= len; x += 32)
+    {
+      mask = _mm256_movemask_epi8 (
+          _mm256_cmpeq_epi8 (_mm256_loadu_si256 ((const __m256i *) (data + x)),
+                             _mm256_setzero_si256 ()));
+      if (mask != 0xffffffff)
+        return x + __builtin_ctz (~mask);
+    }
+#endif
+
+#if defined(__SSE2__)
+  unsigned int mask16;
+
+  for (; x + 16 <= len; x += 16)
+    {
+      mask16 = _mm_movemask_epi8 (
+          _mm_cmpeq_epi8 (_mm_loadu_si128 ((const __m128i *) (data + x)),
+                          _mm_setzero_si128 ()));
+      if (mask16 != 0xffff)
+        return x + __builtin_ctz (~mask16);
+    }
+#endif
+
+  for (; x < len; x++)
+    {
+      if (data[x] != 0)
+        break;
+    }
+
+  return x;
+}
+
+/** Returns number of printable bytes at start of given data.
+ */
+size_t
+count_printable_bytes (const uint8_t *data, size_t len)
+{
+  size_t x = 0;
+
+#if defined(__AVX2__)
+  unsigned int mask;
+
+  for (; x + 32 <= len; x += 32)
+    {
+      mask = printable_mask_256 (
+          _mm256_loadu_si256 ((const __m256i *) (data + x)));
+      if (mask != 0xffffffff)
+        return x + __builtin_ctz (~mask);
+    }
+#endif
+
+#if defined(__SSE2__)
+  unsigned int mask16;
+
+  for (; x + 16 <= len; x += 16)
+    {
+      mask16 = printable_mask (_mm_loadu_si128 ((const __m128i *) (data + x)));
+      if (mask16 != 0xffff)
+        return x + __builtin_ctz (~mask16);
+    }
+#endif
+
+  for (; x < len; x++)
+    {
+      if (!is_printable_byte (data[x]))
+        break;
+    }
+
+  return x;
+}
@@ -0,0 +1,35 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file byte_scan.hpp
+ *     Header file for byte_scan.cpp, with declaration of byte run scanners.
+ * @par Purpose:
+ *     Declares functions which measure runs of zero and of printable
+ *     bytes, used to type data.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#ifndef LEDISASM_BYTE_SCAN_H
+#define LEDISASM_BYTE_SCAN_H
+
+#include <inttypes.h>
+#include <cstddef>
+
+/** Returns true for bytes allowed within a string: printable characters,
+ * tab and line breaks.
+ */
+static inline bool
+is_printable_byte (uint8_t c)
+{
+  return ((c >= 0x20 and c < 0x7f) or c == '\t' or c == '\n' or c == '\r');
+}
+
+size_t count_zero_bytes (const uint8_t *data, size_t len);
+size_t count_printable_bytes (const uint8_t *data, size_t len);
+
+#endif // LEDISASM_BYTE_SCAN_H
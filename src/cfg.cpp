@@ -0,0 +1,415 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file cfg.cpp
+ *     Implementation of ControlFlowGraph class.
+ * @par Purpose:
+ *     Implements building of basic blocks, their edges and functions
+ *     from branches recorded during tracing.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#include <algorithm>
+
+#include "cfg.hpp"
+#include "database.hpp"
+#include "label_table.hpp"
+#include "region_table.hpp"
+#include "shadow_map.hpp"
+
+void
+ControlFlowGraph::clear (void)
+{
+  this->branches.clear ();
+  this->blocks.clear ();
+  this->succ_index.clear ();
+  this->succ.clear ();
+  this->pred_index.clear ();
+  this->pred.clear ();
+  this->entries.clear ();
+  this->member_index.clear ();
+  this->members.clear ();
+}
+
+/* Records traced instruction which ends a basic block. */
+void
+ControlFlowGraph::add_branch (uint32_t addr, Instruction::Type type,
+                              uint32_t target)
+{
+  Branch branch;
+
+  branch.address = addr;
+  branch.target  = target;
+  branch.type    = type;
+  this->branches.push_back (branch);
+}
+
+/** Writes branches recorded while tracing; the graph is built again.
+ */
+void
+ControlFlowGraph::save (DatabaseWriter *db) const
+{
+  size_t n;
+
+  db->put_u32 (this->branches.size ());
+
+  for (n = 0; n < this->branches.size (); n++)
+    {
+      db->put_u32 (this->branches[n].address);
+      db->put_u32 (this->branches[n].target);
+      db->put_u8 (this->branches[n].type);
+    }
+}
+
+void
+ControlFlowGraph::load (DatabaseReader *db)
+{
+  uint32_t count;
+  Branch branch;
+
+  this->clear ();
+
+  for (count = db->get_u32 (); count > 0; count--)
+    {
+      branch.address = db->get_u32 ();
+      branch.target  = db->get_u32 ();
+      branch.type    = (Instruction::Type) db->get_u8 ();
+      this->branches.push_back (branch);
+    }
+}
+
+/* Sorts branches, dropping the ones no longer traced at their address. */
+void
+ControlFlowGraph::compact_branches (const ShadowMap *shadow)
+{
+  size_t kept;
+  size_t n;
+
+  std::stable_sort (this->branches.begin (), this->branches.end (),
+                    [] (const Branch &a, const Branch &b)
+                    {
+                      return a.address < b.address;
+                    });
+
+  kept = 0;
+
+  for (n = 0; n < this->branches.size (); n++)
+    {
+      if (!shadow->is_instruction_start (this->branches[n].address))
+        continue;
+
+      /* Code traced again after an update records its branches again */
+      if (kept > 0
+          and this->branches[kept - 1].address == this->branches[n].address)
+        kept--;
+
+      this->branches[kept++] = this->branches[n];
+    }
+
+  this->branches.resize (kept);
+}
+
+/** Splits code regions into basic blocks.
+ *
+ * Blocks start at code region starts, where tracing started, at branch
+ * targets and labels, and after branches.
+ */
+void
+ControlFlowGraph::find_blocks (const ShadowMap *shadow,
+                               const RegionTable *regions,
+                               const LabelTable *labels)
+{
+  std::vector<uint32_t> leaders;
+  std::vector<uint32_t>::const_iterator leader;
+  std::vector<Branch>::const_iterator branch;
+  RegionTable::const_iterator itr;
+  const Label *label;
+  Block block;
+  uint32_t addr;
+  uint32_t end;
+  size_t n;
+
+  for (n = 0; n < this->branches.size (); n++)
+    {
+      const Branch *br = &this->branches[n];
+
+      if (br->type != Instruction::RET and br->target != 0
+          and shadow->is_instruction_start (br->target))
+        leaders.push_back (br->target);
+    }
+
+  for (n = 0; n < labels->size (); n++)
+    {
+      label = &labels->get_sorted (n);
+
+      if ((label->get_type () == Label::FUNCTION
+           or label->get_type () == Label::JUMP)
+          and shadow->is_instruction_start (label->get_address ()))
+        leaders.push_back (label->get_address ());
+    }
+
+  std::sort (leaders.begin (), leaders.end ());
+  leaders.erase (std::unique (leaders.begin (), leaders.end ()),
+                 leaders.end ());
+
+  leader = leaders.begin ();
+  branch = this->branches.begin ();
+  block.function = NO_FUNCTION;
+
+  for (itr = regions->begin (); itr != regions->end (); ++itr)
+    {
+      if (itr->get_type () != Region::CODE)
+        continue;
+
+      addr = itr->get_address ();
+      end  = itr->get_end_address ();
+      block.start = addr;
+
+      while (addr < end)
+        {
+          /* Find end of the instruction */
+          for (n = addr + 1; n < end; n++)
+            {
+              if (shadow->is_instruction_start (n))
+                break;
+            }
+
+          while (leader != leaders.end () and *leader < n)
+            ++leader;
+          while (branch != this->branches.end () and branch->address < addr)
+            ++branch;
+
+          if (n == end
+              or (leader != leaders.end () and *leader == n)
+              or (shadow->get_flags (n) & ShadowMap::TRACED) != 0
+              or (branch != this->branches.end ()
+                  and branch->address == addr))
+            {
+              block.end = n;
+              this->blocks.push_back (block);
+              block.start = n;
+            }
+
+          addr = n;
+        }
+    }
+}
+
+/* Connects blocks by jumps and by falling through. */
+void
+ControlFlowGraph::link_blocks (void)
+{
+  std::vector<Branch>::const_iterator branch;
+  std::vector<uint32_t> edges;
+  std::vector<uint32_t> counts;
+  const Block *block;
+  size_t target;
+  size_t n;
+  size_t e;
+  bool falls;
+
+  this->succ_index.assign (1, 0);
+  branch = this->branches.begin ();
+
+  for (n = 0; n < this->blocks.size (); n++)
+    {
+      block = &this->blocks[n];
+      falls = true;
+
+      /* The last branch within the block is the one ending it */
+      while (branch != this->branches.end () and branch->address < block->end)
+        ++branch;
+
+      if (branch != this->branches.begin ()
+          and (branch - 1)->address >= block->start)
+        {
+          const Branch *br = &*(branch - 1);
+
+          if (br->type != Instruction::RET and br->target != 0)
+            {
+              target = this->find_block (br->target);
+              if (target < this->blocks.size ()
+                  and this->blocks[target].start == br->target)
+                this->succ.push_back (target);
+            }
+
+          falls = (br->type == Instruction::COND_JUMP);
+        }
+
+      if (falls and n + 1 < this->blocks.size ()
+          and this->blocks[n + 1].start == block->end)
+        this->succ.push_back (n + 1);
+
+      this->succ_index.push_back (this->succ.size ());
+    }
+
+  /* Predecessors are successors turned around, by counting sort */
+  counts.assign (this->blocks.size () + 1, 0);
+  for (e = 0; e < this->succ.size (); e++)
+    counts[this->succ[e] + 1]++;
+
+  for (n = 0; n < this->blocks.size (); n++)
+    counts[n + 1] += counts[n];
+
+  this->pred_index = counts;
+  this->pred.resize (this->succ.size ());
+
+  for (n = 0; n < this->blocks.size (); n++)
+    {
+      for (e = this->succ_index[n]; e < this->succ_index[n + 1]; e++)
+        this->pred[counts[this->succ[e]]++] = n;
+    }
+}
+
+/* Assigns blocks to functions, walking from their entries. */
+void
+ControlFlowGraph::find_functions (const LabelTable *labels)
+{
+  std::vector<uint32_t> stack;
+  std::vector<uint32_t> counts;
+  const Label *label;
+  uint32_t function;
+  uint32_t index;
+  size_t n;
+  size_t e;
+
+  for (n = 0; n < this->blocks.size (); n++)
+    {
+      label = labels->find (this->blocks[n].start);
+      if (label != NULL and label->get_type () == Label::FUNCTION)
+        this->entries.push_back (n);
+    }
+
+  /* Entries belong to their own functions, even when jumped to */
+  for (function = 0; function < this->entries.size (); function++)
+    this->blocks[this->entries[function]].function = function;
+
+  for (function = 0; function < this->entries.size (); function++)
+    {
+      stack.push_back (this->entries[function]);
+
+      while (!stack.empty ())
+        {
+          index = stack.back ();
+          stack.pop_back ();
+
+          for (e = this->succ_index[index]; e < this->succ_index[index + 1];
+               e++)
+            {
+              if (this->blocks[this->succ[e]].function == NO_FUNCTION)
+                {
+                  this->blocks[this->succ[e]].function = function;
+                  stack.push_back (this->succ[e]);
+                }
+            }
+        }
+    }
+
+  counts.assign (this->entries.size () + 1, 0);
+  for (n = 0; n < this->blocks.size (); n++)
+    {
+      if (this->blocks[n].function != NO_FUNCTION)
+        counts[this->blocks[n].function + 1]++;
+    }
+
+  for (n = 0; n < this->entries.size (); n++)
+    counts[n + 1] += counts[n];
+
+  this->member_index = counts;
+  this->members.resize (counts.back ());
+
+  for (n = 0; n < this->blocks.size (); n++)
+    {
+      if (this->blocks[n].function != NO_FUNCTION)
+        this->members[counts[this->blocks[n].function]++] = n;
+    }
+}
+
+/** Builds the graph of code in given state of analysis.
+ *
+ * Branches recorded so far are kept, so the graph can be built again
+ * after further tracing.
+ */
+void
+ControlFlowGraph::build (const ShadowMap *shadow, const RegionTable *regions,
+                         const LabelTable *labels)
+{
+  this->blocks.clear ();
+  this->succ.clear ();
+  this->pred.clear ();
+  this->entries.clear ();
+  this->members.clear ();
+
+  this->compact_branches (shadow);
+  this->find_blocks (shadow, regions, labels);
+  this->link_blocks ();
+  this->find_functions (labels);
+}
+
+size_t
+ControlFlowGraph::get_block_count (void) const
+{
+  return this->blocks.size ();
+}
+
+const ControlFlowGraph::Block *
+ControlFlowGraph::get_block (size_t index) const
+{
+  return &this->blocks[index];
+}
+
+/* Returns index of block containing given address, or block count. */
+size_t
+ControlFlowGraph::find_block (uint32_t addr) const
+{
+  std::vector<Block>::const_iterator itr;
+
+  itr = std::upper_bound (this->blocks.begin (), this->blocks.end (), addr,
+                          [] (uint32_t addr, const Block &block)
+                          {
+                            return addr < block.start;
+                          });
+  if (itr == this->blocks.begin () or (itr - 1)->end <= addr)
+    return this->blocks.size ();
+
+  return (itr - 1) - this->blocks.begin ();
+}
+
+const uint32_t *
+ControlFlowGraph::get_successors (size_t block, size_t *count) const
+{
+  *count = this->succ_index[block + 1] - this->succ_index[block];
+  return this->succ.data () + this->succ_index[block];
+}
+
+const uint32_t *
+ControlFlowGraph::get_predecessors (size_t block, size_t *count) const
+{
+  *count = this->pred_index[block + 1] - this->pred_index[block];
+  return this->pred.data () + this->pred_index[block];
+}
+
+size_t
+ControlFlowGraph::get_function_count (void) const
+{
+  return this->entries.size ();
+}
+
+/* Returns index of entry block of a function. */
+size_t
+ControlFlowGraph::get_function_entry (size_t function) const
+{
+  return this->entries[function];
+}
+
+const uint32_t *
+ControlFlowGraph::get_function_blocks (size_t function, size_t *count) const
+{
+  *count = this->member_index[function + 1] - this->member_index[function];
+  return this->members.data () + this->member_index[function];
+}
@@ -0,0 +1,102 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file cfg.hpp
+ *     Header file for cfg.cpp, with declaration of ControlFlowGraph class.
+ * @par Purpose:
+ *     Storage for ControlFlowGraph class which keeps basic blocks of the
+ *     traced code, edges between them and functions they belong to.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#ifndef LEDISASM_CFG_H
+#define LEDISASM_CFG_H
+
+#include <inttypes.h>
+#include <cstddef>
+#include <vector>
+
+#include "instruction.hpp"
+
+class DatabaseReader;
+class DatabaseWriter;
+class ShadowMap;
+class RegionTable;
+class LabelTable;
+
+/** Basic blocks of traced code, with their edges and functions.
+ *
+ * Tracing only records instructions which end a block, so building
+ * the graph needs no decoding; block boundaries come from instruction
+ * starts kept in the shadow map.
+ *
+ * Everything is kept in contiguous arrays. Successors, predecessors
+ * and blocks of every function are stored in compressed sparse row
+ * form: items of entry n lie between index[n] and index[n + 1].
+ * Functions start at blocks with a function label; every other block
+ * belongs to the first function, in address order, it is reachable
+ * from without calls, if any.
+ */
+class ControlFlowGraph
+{
+public:
+  static const uint32_t NO_FUNCTION = 0xffffffff;
+
+  struct Block
+  {
+    uint32_t start;
+    uint32_t end;
+    uint32_t function;
+  };
+
+protected:
+  struct Branch
+  {
+    uint32_t          address;
+    uint32_t          target;
+    Instruction::Type type;
+  };
+
+  std::vector<Branch>   branches;
+  std::vector<Block>    blocks;
+  std::vector<uint32_t> succ_index;
+  std::vector<uint32_t> succ;
+  std::vector<uint32_t> pred_index;
+  std::vector<uint32_t> pred;
+  std::vector<uint32_t> entries;
+  std::vector<uint32_t> member_index;
+  std::vector<uint32_t> members;
+
+protected:
+  void compact_branches (const ShadowMap *shadow);
+  void find_blocks (const ShadowMap *shadow, const RegionTable *regions,
+                    const LabelTable *labels);
+  void link_blocks (void);
+  void find_functions (const LabelTable *labels);
+
+public:
+  void clear (void);
+  void add_branch (uint32_t addr, Instruction::Type type, uint32_t target);
+  void build (const ShadowMap *shadow, const RegionTable *regions,
+              const LabelTable *labels);
+
+  void save (DatabaseWriter *db) const;
+  void load (DatabaseReader *db);
+
+  size_t get_block_count (void) const;
+  const Block *get_block (size_t index) const;
+  size_t find_block (uint32_t addr) const;
+  const uint32_t *get_successors (size_t block, size_t *count) const;
+  const uint32_t *get_predecessors (size_t block, size_t *count) const;
+
+  size_t get_function_count (void) const;
+  size_t get_function_entry (size_t function) const;
+  const uint32_t *get_function_blocks (size_t function, size_t *count) const;
+};
+
+#endif // LEDISASM_CFG_H
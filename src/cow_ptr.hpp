@@ -0,0 +1,51 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file cow_ptr.hpp
+ *     Header file with definition of CowPtr template.
+ * @par Purpose:
+ *     Storage for CowPtr template, a pointer to a value shared between
+ *     copies until one of them modifies it.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#ifndef LEDISASM_COW_PTR_H
+#define LEDISASM_COW_PTR_H
+
+#include <memory>
+
+/** Copy-on-write pointer.
+ *
+ * Copying the pointer only shares the value; edit () makes a private
+ * copy first if the value is shared. Values may be read concurrently,
+ * but copying and editing must be done by one thread.
+ */
+template <typename T>
+class CowPtr
+{
+protected:
+  std::shared_ptr<T> ptr;
+
+public:
+  CowPtr (void) : ptr (std::make_shared<T> ()) {}
+  explicit CowPtr (const T &value) : ptr (std::make_shared<T> (value)) {}
+
+  const T &operator* (void) const { return *this->ptr; }
+  const T *operator-> (void) const { return this->ptr.get (); }
+  const T *get (void) const { return this->ptr.get (); }
+
+  T *edit (void)
+  {
+    if (this->ptr.use_count () > 1)
+      this->ptr = std::make_shared<T> (*this->ptr);
+
+    return this->ptr.get ();
+  }
+};
+
+#endif // LEDISASM_COW_PTR_H
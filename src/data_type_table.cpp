@@ -0,0 +1,414 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file data_type_table.cpp
+ *     Implementation of DataTypeTable class.
+ * @par Purpose:
+ *     Implements classification of data regions into typed sub-regions,
+ *     done once after the analysis instead of on every output.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "byte_scan.hpp"
+#include "data_type_table.hpp"
+#include "label.hpp"
+#include "label_table.hpp"
+#include "le.hpp"
+#include "region_table.hpp"
+#include "util.hpp"
+
+/* Shortest runs typed as a fill, a string or a table */
+static const size_t min_zeros_length = 4;
+static const size_t min_string_length = 4;
+static const size_t min_double_count = 3;
+static const size_t min_float_count = 4;
+static const size_t min_int32_count = 4;
+static const size_t min_int16_count = 8;
+
+static bool
+address_less (const Region &reg, uint32_t addr)
+{
+  return reg.get_address () < addr;
+}
+
+/* Normal floats between 2^-16 and 2^24, either sign, written with at most
+ * 6 significant digits; arbitrary bytes rarely make such a value. */
+static bool
+is_plausible_float (uint32_t bits)
+{
+  uint32_t exponent;
+  char buffer[32];
+  float value;
+
+  exponent = (bits >> 23) & 0xff;
+  if (exponent < 127 - 16 or exponent > 127 + 24)
+    return false;
+
+  memcpy (&value, &bits, sizeof (value));
+  snprintf (buffer, sizeof (buffer), "%.6g", value);
+  return (strtof (buffer, NULL) == value);
+}
+
+/* Normal doubles in the same range, written with at most 10 significant
+ * digits; pairs of floats such as 1.0f fill the low mantissa bits and
+ * need all 17. */
+static bool
+is_plausible_double (uint64_t bits)
+{
+  uint32_t exponent;
+  char buffer[32];
+  double value;
+
+  exponent = (bits >> 52) & 0x7ff;
+  if (exponent < 1023 - 16 or exponent > 1023 + 24)
+    return false;
+
+  memcpy (&value, &bits, sizeof (value));
+  snprintf (buffer, sizeof (buffer), "%.10g", value);
+  return (strtod (buffer, NULL) == value);
+}
+
+static bool
+is_small_int32 (uint32_t bits)
+{
+  int32_t value = (int32_t) bits;
+
+  return (value != 0 and value > -0x10000 and value < 0x10000);
+}
+
+static bool
+is_small_int16 (uint16_t bits)
+{
+  int16_t value = (int16_t) bits;
+
+  return (value != 0 and value > -0x1000 and value < 0x1000);
+}
+
+void
+DataTypeTable::append (const Region &reg, bool joinable)
+{
+  Region *last;
+
+  if (joinable and not this->entries.empty ())
+    {
+      last = &this->entries.back ();
+
+      if (last->get_end_address () == reg.get_address ())
+        {
+          if (reg.get_type () == Region::BYTES
+              and last->get_type () == Region::BYTES)
+            {
+              *last = Region (last->get_address (),
+                              last->get_size () + reg.get_size (),
+                              Region::BYTES);
+              return;
+            }
+
+          if (reg.get_type () == Region::POINTER
+              and (last->get_type () == Region::POINTER
+                   or last->get_type () == Region::POINTER_ARRAY))
+            {
+              *last = Region (last->get_address (),
+                              last->get_size () + reg.get_size (),
+                              Region::POINTER_ARRAY);
+              return;
+            }
+        }
+    }
+
+  this->entries.push_back (reg);
+}
+
+/** Returns length of an aligned numeric table at given address, or 0.
+ */
+size_t
+DataTypeTable::match_table (const Image::Object *obj, uint32_t addr,
+                            size_t len, Region::Type *type)
+{
+  const uint8_t *data;
+  size_t n;
+
+  data = obj->get_data_at (addr);
+
+  if (addr % 8 == 0)
+    {
+      for (n = 0; (n + 1) * 8 <= len; n++)
+        {
+          if (!is_plausible_double (read_le<uint64_t> (data + n * 8)))
+            break;
+        }
+
+      if (n >= min_double_count)
+        {
+          *type = Region::DOUBLE_TABLE;
+          return n * 8;
+        }
+    }
+
+  if (addr % 4 == 0)
+    {
+      for (n = 0; (n + 1) * 4 <= len; n++)
+        {
+          if (!is_plausible_float (read_le<uint32_t> (data + n * 4)))
+            break;
+        }
+
+      if (n >= min_float_count)
+        {
+          *type = Region::FLOAT_TABLE;
+          return n * 4;
+        }
+
+      for (n = 0; (n + 1) * 4 <= len; n++)
+        {
+          if (!is_small_int32 (read_le<uint32_t> (data + n * 4)))
+            break;
+        }
+
+      if (n >= min_int32_count)
+        {
+          *type = Region::INT32_TABLE;
+          return n * 4;
+        }
+    }
+
+  if (addr % 2 == 0)
+    {
+      for (n = 0; (n + 1) * 2 <= len; n++)
+        {
+          if (!is_small_int16 (read_le<uint16_t> (data + n * 2)))
+            break;
+        }
+
+      if (n >= min_int16_count)
+        {
+          *type = Region::INT16_TABLE;
+          return n * 2;
+        }
+    }
+
+  return 0;
+}
+
+/** Types bytes which are neither pointers, fills nor strings.
+ */
+void
+DataTypeTable::type_bytes (const Image::Object *obj, uint32_t addr,
+                           size_t len, bool joinable)
+{
+  Region::Type type;
+  uint32_t start;
+  uint32_t end;
+  size_t size;
+
+  start = addr;
+  end = addr + len;
+
+  while (addr < end)
+    {
+      size = match_table (obj, addr, end - addr, &type);
+      if (size == 0)
+        {
+          addr++;
+          continue;
+        }
+
+      if (start < addr)
+        {
+          this->append (Region (start, addr - start, Region::BYTES),
+                        joinable);
+          joinable = true;
+        }
+
+      this->append (Region (addr, size, type), joinable);
+      joinable = true;
+      addr += size;
+      start = addr;
+    }
+
+  if (start < end)
+    this->append (Region (start, end - start, Region::BYTES), joinable);
+}
+
+/** Types data between neighbouring labels and relocations.
+ */
+void
+DataTypeTable::type_chunk (const Image::Object *obj, uint32_t addr,
+                           size_t len, bool is_pointer, bool at_label)
+{
+  const uint8_t *data;
+  uint32_t bytes_start;
+  size_t size;
+  bool joinable;
+
+  joinable = !at_label;
+  bytes_start = addr;
+
+  while (len > 0)
+    {
+      data = obj->get_data_at (addr);
+
+      if (is_pointer and len >= 4)
+        {
+          this->append (Region (addr, 4, Region::POINTER), joinable);
+          joinable = true;
+          is_pointer = false;
+          addr += 4;
+          len -= 4;
+          bytes_start = addr;
+          continue;
+        }
+
+      is_pointer = false;
+
+      /* A byte starts either a run of zeros or a printable one, never
+       * both, so a single scan tells what follows */
+      if (data[0] == 0)
+        size = count_zero_bytes (data, len);
+      else
+        size = count_printable_bytes (data, len);
+
+      if (data[0] == 0 and size >= min_zeros_length)
+        {
+          if (bytes_start < addr)
+            {
+              this->type_bytes (obj, bytes_start, addr - bytes_start,
+                                joinable);
+              joinable = true;
+            }
+
+          this->append (Region (addr, size, Region::ZERO_FILL), joinable);
+          joinable = true;
+          addr += size;
+          len -= size;
+          bytes_start = addr;
+          continue;
+        }
+
+      if (data[0] != 0 and size >= min_string_length)
+        {
+          if (bytes_start < addr)
+            {
+              this->type_bytes (obj, bytes_start, addr - bytes_start,
+                                joinable);
+              joinable = true;
+            }
+
+          if (size < len and data[size] == 0)
+            this->append (Region (addr, size + 1, Region::C_STRING),
+                          joinable);
+          else
+            this->append (Region (addr, size, Region::ASCII), joinable);
+
+          joinable = true;
+          size = this->entries.back ().get_size ();
+          addr += size;
+          len -= size;
+          bytes_start = addr;
+          continue;
+        }
+
+      /* Any later byte of a run too short is in a shorter one */
+      size = std::max<size_t> (size, 1);
+      addr += size;
+      len -= size;
+    }
+
+  if (bytes_start < addr)
+    this->type_bytes (obj, bytes_start, addr - bytes_start, joinable);
+}
+
+void
+DataTypeTable::type_region (const Region *reg, const LinearExecutable *le,
+                            const Image *img, const LabelTable *labels)
+{
+  const Image::Object *obj;
+  const LEFM *fixups;
+  LEFM::const_iterator itr;
+  const Label *label;
+  uint32_t offset;
+  uint32_t addr;
+  size_t len;
+  bool is_pointer;
+
+  obj = img->get_object_at_address (reg->get_address ());
+  fixups = le->get_fixups_for_object (obj->get_index ());
+  itr = fixups->begin ();
+  addr = reg->get_address ();
+
+  while (addr < reg->get_end_address ())
+    {
+      len = reg->get_end_address () - addr;
+
+      label = labels->find_next (addr);
+      if (label != NULL)
+        len = std::min<size_t> (len, label->get_address () - addr);
+
+      offset = addr - obj->get_base_address ();
+      is_pointer = (fixups->find (offset) != fixups->end ());
+
+      while (itr != fixups->end () and itr->first <= offset)
+        ++itr;
+
+      if (itr != fixups->end ())
+        len = std::min<size_t> (len, itr->first - offset);
+
+      this->type_chunk (obj, addr, len, is_pointer,
+                        labels->find (addr) != NULL);
+      addr += len;
+    }
+}
+
+void
+DataTypeTable::clear (void)
+{
+  this->entries.clear ();
+}
+
+void
+DataTypeTable::build (const LinearExecutable *le, const Image *img,
+                      const RegionTable *regions, const LabelTable *labels)
+{
+  RegionTable::const_iterator itr;
+
+  this->entries.clear ();
+
+  for (itr = regions->begin (); itr != regions->end (); ++itr)
+    {
+      if (itr->get_type () == Region::DATA)
+        this->type_region (&*itr, le, img, labels);
+    }
+}
+
+size_t
+DataTypeTable::size (void) const
+{
+  return this->entries.size ();
+}
+
+/** Returns the typed sub-regions of a DATA region.
+ */
+const Region *
+DataTypeTable::find_within (const Region *reg, size_t *count) const
+{
+  std::vector<Region>::const_iterator first;
+  std::vector<Region>::const_iterator last;
+
+  first = std::lower_bound (this->entries.begin (), this->entries.end (),
+                            reg->get_address (), address_less);
+  last = std::lower_bound (first, this->entries.end (),
+                           (uint32_t) reg->get_end_address (), address_less);
+
+  *count = last - first;
+  return (first == last ? NULL : &*first);
+}
@@ -0,0 +1,70 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file data_type_table.hpp
+ *     Header file for data_type_table.cpp, with declaration of DataTypeTable.
+ * @par Purpose:
+ *     Storage for DataTypeTable class which divides data regions into
+ *     pointers, strings, fills, numeric tables and opaque bytes.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#ifndef LEDISASM_DATA_TYPE_TABLE_H
+#define LEDISASM_DATA_TYPE_TABLE_H
+
+#include <inttypes.h>
+#include <cstddef>
+#include <vector>
+
+#include "image.hpp"
+#include "regions.hpp"
+
+class LabelTable;
+class LinearExecutable;
+class RegionTable;
+
+/** Typed sub-regions of the DATA regions.
+ *
+ * Every DATA region is cut at labels and relocations, and each piece
+ * is classified the way it is to be printed: a relocation is a pointer,
+ * runs of at least four zeros are a fill, runs of at least four
+ * printable characters are a string, and the rest are bytes. Within
+ * the bytes, aligned runs of plausible floats, doubles and small
+ * integers are typed as tables.
+ *
+ * Sub-regions are sorted by address and cover the DATA regions
+ * completely. Neighbouring pointers and bytes are joined unless
+ * there is a label between them.
+ */
+class DataTypeTable
+{
+protected:
+  std::vector<Region> entries;
+
+protected:
+  void append (const Region &reg, bool joinable);
+  void type_region (const Region *reg, const LinearExecutable *le,
+                    const Image *img, const LabelTable *labels);
+  void type_chunk (const Image::Object *obj, uint32_t addr, size_t len,
+                   bool is_pointer, bool at_label);
+  void type_bytes (const Image::Object *obj, uint32_t addr, size_t len,
+                   bool joinable);
+
+  static size_t match_table (const Image::Object *obj, uint32_t addr,
+                             size_t len, Region::Type *type);
+
+public:
+  void clear (void);
+  void build (const LinearExecutable *le, const Image *img,
+              const RegionTable *regions, const LabelTable *labels);
+
+  size_t size (void) const;
+  const Region *find_within (const Region *reg, size_t *count) const;
+};
+
+#endif // LEDISASM_DATA_TYPE_TABLE_H
@@ -0,0 +1,224 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file database.cpp
+ *     Implementation of AnalysisDatabase and its encoding helpers.
+ * @par Purpose:
+ *     Implements writing and reading of the analysis state to and from
+ *     a file keyed by hashes of the input and of the configuration.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "config.h"
+
+#include "database.hpp"
+#include "analyser.hpp"
+#include "error.hpp"
+#include "util.hpp"
+
+static const char magic[4] = { 'L', 'E', 'D', 'B' };
+
+void
+DatabaseWriter::put_u8 (uint8_t value)
+{
+  this->data.push_back (value);
+}
+
+void
+DatabaseWriter::put_u32 (uint32_t value)
+{
+  uint8_t buffer[4];
+
+  write_le<uint32_t> (buffer, value);
+  this->data.insert (this->data.end (), buffer, buffer + sizeof (buffer));
+}
+
+void
+DatabaseWriter::put_u64 (uint64_t value)
+{
+  uint8_t buffer[8];
+
+  write_le<uint64_t> (buffer, value);
+  this->data.insert (this->data.end (), buffer, buffer + sizeof (buffer));
+}
+
+void
+DatabaseWriter::put_string (const std::string &str)
+{
+  this->put_u32 (str.size ());
+  this->data.insert (this->data.end (), str.begin (), str.end ());
+}
+
+const std::vector<uint8_t> *
+DatabaseWriter::get_data (void) const
+{
+  return &this->data;
+}
+
+DatabaseReader::DatabaseReader (const uint8_t *data, size_t size)
+{
+  this->data = data;
+  this->size = size;
+  this->pos  = 0;
+}
+
+const uint8_t *
+DatabaseReader::take (size_t len)
+{
+  const uint8_t *p;
+
+  if (len > this->size - this->pos)
+    throw Error () << "Analysis database is truncated";
+
+  p = this->data + this->pos;
+  this->pos += len;
+  return p;
+}
+
+uint8_t
+DatabaseReader::get_u8 (void)
+{
+  return *this->take (1);
+}
+
+uint32_t
+DatabaseReader::get_u32 (void)
+{
+  return read_le<uint32_t> (this->take (4));
+}
+
+uint64_t
+DatabaseReader::get_u64 (void)
+{
+  return read_le<uint64_t> (this->take (8));
+}
+
+std::string
+DatabaseReader::get_string (void)
+{
+  const uint8_t *p;
+  uint32_t len;
+
+  len = this->get_u32 ();
+  p = this->take (len);
+  return std::string ((const char *) p, len);
+}
+
+bool
+DatabaseReader::at_end (void) const
+{
+  return (this->pos == this->size);
+}
+
+/** Returns hash of the whole input file, leaving the stream rewound.
+ */
+uint64_t
+AnalysisDatabase::hash_input (std::istream *is)
+{
+  char buffer[65536];
+  uint64_t hash;
+
+  hash = fnv1a_offset_basis;
+
+  is->clear ();
+  is->seekg (0);
+
+  while (is->read (buffer, sizeof (buffer)) or is->gcount () > 0)
+    hash = fnv1a_hash (buffer, is->gcount (), hash);
+
+  is->clear ();
+  is->seekg (0);
+
+  return hash;
+}
+
+/** Loads the analysis if the file exists and matches given keys.
+ */
+bool
+AnalysisDatabase::load (const char *fname, uint64_t input_hash,
+                        uint64_t config_hash, Analyser *anal)
+{
+  std::ifstream ifs;
+  std::vector<uint8_t> data;
+
+  ifs.open (fname, std::ios::binary);
+  if (!ifs.is_open ())
+    return false;
+
+  data.assign (std::istreambuf_iterator<char> (ifs),
+               std::istreambuf_iterator<char> ());
+
+  if (data.size () < sizeof (magic)
+      or memcmp (data.data (), magic, sizeof (magic)) != 0)
+    throw Error () << "Not an analysis database: " << fname;
+
+  DatabaseReader db (data.data () + sizeof (magic),
+                     data.size () - sizeof (magic));
+
+  if (db.get_u32 () != FORMAT_VERSION
+      or db.get_string () != PACKAGE_VERSION
+      or db.get_u32 () != Analyser::REVISION
+      or db.get_u64 () != input_hash
+      or db.get_u64 () != config_hash)
+    {
+      std::cerr << "Analysis database " << fname << " is out of date.\n";
+      return false;
+    }
+
+  anal->load (&db);
+
+  if (!db.at_end ())
+    throw Error () << "Analysis database has trailing data: " << fname;
+
+  std::cerr << "Analysis loaded from " << fname << ".\n";
+  return true;
+}
+
+/** Saves the analysis, replacing the file only once it is complete.
+ */
+void
+AnalysisDatabase::save (const char *fname, uint64_t input_hash,
+                        uint64_t config_hash, const Analyser *anal)
+{
+  DatabaseWriter db;
+  const std::vector<uint8_t> *data;
+  std::string tmp_fname;
+  std::ofstream ofs;
+  size_t n;
+
+  for (n = 0; n < sizeof (magic); n++)
+    db.put_u8 (magic[n]);
+
+  db.put_u32 (FORMAT_VERSION);
+  db.put_string (PACKAGE_VERSION);
+  db.put_u32 (Analyser::REVISION);
+  db.put_u64 (input_hash);
+  db.put_u64 (config_hash);
+  anal->save (&db);
+
+  data = db.get_data ();
+  tmp_fname = std::string (fname) + ".tmp";
+
+  ofs.open (tmp_fname.c_str (), std::ios::binary | std::ios::trunc);
+  if (!ofs.is_open ())
+    throw Error () << "Error creating file: " << tmp_fname;
+
+  ofs.write ((const char *) data->data (), data->size ());
+  ofs.close ();
+
+  if (!ofs or std::rename (tmp_fname.c_str (), fname) != 0)
+    {
+      std::remove (tmp_fname.c_str ());
+      throw Error () << "Error writing file: " << fname;
+    }
+}
@@ -0,0 +1,89 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file database.hpp
+ *     Header file for database.cpp, with declaration of AnalysisDatabase.
+ * @par Purpose:
+ *     Storage for AnalysisDatabase class which keeps final state of the
+ *     analysis in a file, so later runs on the same input can skip it.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#ifndef LEDISASM_DATABASE_H
+#define LEDISASM_DATABASE_H
+
+#include <inttypes.h>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+class Analyser;
+
+/** Encodes values into a little-endian byte buffer. */
+class DatabaseWriter
+{
+protected:
+  std::vector<uint8_t> data;
+
+public:
+  void put_u8 (uint8_t value);
+  void put_u32 (uint32_t value);
+  void put_u64 (uint64_t value);
+  void put_string (const std::string &str);
+
+  const std::vector<uint8_t> *get_data (void) const;
+};
+
+/** Decodes values written by DatabaseWriter; throws on truncated data. */
+class DatabaseReader
+{
+protected:
+  const uint8_t *data;
+  size_t size;
+  size_t pos;
+
+protected:
+  const uint8_t *take (size_t len);
+
+public:
+  DatabaseReader (const uint8_t *data, size_t size);
+
+  uint8_t  get_u8 (void);
+  uint32_t get_u32 (void);
+  uint64_t get_u64 (void);
+  std::string get_string (void);
+  bool at_end (void) const;
+};
+
+/** File with final state of the analysis of one executable.
+ *
+ * The file starts with "LEDB", format version, package version and
+ * Analyser::REVISION, hash of the input file and hash of the analysis
+ * configuration, which covers the trace order and the regions and labels
+ * applied before the analysis. A file whose keys do not match, including
+ * one saved by another build, is ignored and written again after
+ * the analysis.
+ *
+ * Only the state needed to print and query the analysis is kept:
+ * the shadow map with instruction starts, labels, and references and
+ * branches recorded while tracing. Loaded analysis cannot be continued.
+ */
+class AnalysisDatabase
+{
+public:
+  static const uint32_t FORMAT_VERSION = 1;
+
+  static uint64_t hash_input (std::istream *is);
+  static bool load (const char *fname, uint64_t input_hash,
+                    uint64_t config_hash, Analyser *anal);
+  static void save (const char *fname, uint64_t input_hash,
+                    uint64_t config_hash, const Analyser *anal);
+};
+
+#endif // LEDISASM_DATABASE_H
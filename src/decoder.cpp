@@ -0,0 +1,399 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file decoder.cpp
+ *     Native decoder of the most common i386 instructions.
+ * @par Purpose:
+ *     Decodes instruction bytes into operand records. Only plain 32-bit
+ *     encodings without prefixes are recognised; anything else is left
+ *     for the disassembler library.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#include <cstring>
+
+#include "decoder.hpp"
+#include "util.hpp"
+
+typedef DecodedInstruction DI;
+
+static void
+set_register (Operand *op, uint8_t size, unsigned int reg)
+{
+  memset (op, 0, sizeof (*op));
+  op->type  = Operand::REGISTER;
+  op->size  = size;
+  op->value = reg;
+}
+
+static bool
+set_immediate (Operand *op, uint8_t size, const uint8_t *data,
+               size_t length, size_t *pos, uint8_t field_size)
+{
+  if (*pos + field_size > length)
+    return false;
+
+  memset (op, 0, sizeof (*op));
+  op->type         = Operand::IMMEDIATE;
+  op->size         = size;
+  op->field_offset = *pos;
+  op->field_size   = field_size;
+
+  if (field_size == 1)
+    {
+      op->value = (uint32_t) (int32_t) read_s8 (data + *pos);
+      if (size == 1)
+        op->value &= 0xff;
+    }
+  else if (field_size == 2)
+    op->value = read_le<uint16_t> (data + *pos);
+  else
+    op->value = read_le<uint32_t> (data + *pos);
+
+  *pos += field_size;
+  return true;
+}
+
+static bool
+set_target (Operand *op, uint32_t addr, const uint8_t *data,
+            size_t length, size_t *pos, uint8_t field_size)
+{
+  int32_t rel;
+
+  if (*pos + field_size > length)
+    return false;
+
+  if (field_size == 1)
+    rel = read_s8 (data + *pos);
+  else
+    rel = read_le<int32_t> (data + *pos);
+
+  memset (op, 0, sizeof (*op));
+  op->type         = Operand::TARGET;
+  op->size         = 4;
+  op->field_offset = *pos;
+  op->field_size   = field_size;
+
+  *pos += field_size;
+  op->value = addr + *pos + rel;
+  return true;
+}
+
+/* Decodes ModR/M (and SIB) at *pos; the r/m part goes into rm,
+ * the reg field is returned through reg. */
+static bool
+decode_modrm (const uint8_t *data, size_t length, size_t *pos,
+              uint8_t size, Operand *rm, unsigned int *reg)
+{
+  uint8_t modrm;
+  uint8_t sib;
+  unsigned int mod;
+
+  if (*pos >= length)
+    return false;
+
+  modrm = data[(*pos)++];
+  mod   = modrm >> 6;
+  *reg  = (modrm >> 3) & 7;
+
+  if (mod == 3)
+    {
+      set_register (rm, size, modrm & 7);
+      return true;
+    }
+
+  memset (rm, 0, sizeof (*rm));
+  rm->type  = Operand::MEMORY;
+  rm->size  = size;
+  rm->base  = modrm & 7;
+  rm->index = -1;
+
+  if ((modrm & 7) == 4)
+    {
+      if (*pos >= length)
+        return false;
+
+      sib = data[(*pos)++];
+      rm->sib   = true;
+      rm->scale = sib >> 6;
+      rm->index = (sib >> 3) & 7;
+      rm->base  = sib & 7;
+
+      if (rm->base == 5 and mod == 0)
+        {
+          rm->base = -1;
+          rm->disp_size = 4;
+        }
+    }
+  else if (rm->base == 5 and mod == 0)
+    {
+      rm->base = -1;
+      rm->disp_size = 4;
+    }
+
+  if (mod == 1)
+    rm->disp_size = 1;
+  else if (mod == 2)
+    rm->disp_size = 4;
+
+  if (rm->disp_size != 0)
+    {
+      if (*pos + rm->disp_size > length)
+        return false;
+
+      rm->field_offset = *pos;
+      rm->field_size   = rm->disp_size;
+
+      if (rm->disp_size == 1)
+        rm->value = (uint32_t) (int32_t) read_s8 (data + *pos);
+      else
+        rm->value = read_le<uint32_t> (data + *pos);
+
+      *pos += rm->disp_size;
+    }
+
+  return true;
+}
+
+/* Operands of the "E, G" form, with direction bit selecting the order. */
+static bool
+decode_modrm_pair (const uint8_t *data, size_t length, size_t *pos,
+                   uint8_t size, bool reg_first, DI *ret)
+{
+  unsigned int reg;
+  Operand *rm_op;
+  Operand *reg_op;
+
+  rm_op  = &ret->operands[reg_first ? 1 : 0];
+  reg_op = &ret->operands[reg_first ? 0 : 1];
+
+  if (!decode_modrm (data, length, pos, size, rm_op, &reg))
+    return false;
+
+  set_register (reg_op, size, reg);
+  ret->operand_count = 2;
+  return true;
+}
+
+bool
+decode_instruction (uint32_t addr, const void *data, size_t length,
+                    DecodedInstruction *ret)
+{
+  const uint8_t *p;
+  uint8_t opcode;
+  uint8_t size;
+  unsigned int reg;
+  size_t pos;
+
+  p = (const uint8_t *) data;
+
+  if (length == 0)
+    return false;
+
+  pos = 1;
+  opcode = p[0];
+
+  ret->operand_count = 0;
+  ret->size_suffix   = false;
+
+  if (opcode < 0x40 and (opcode & 7) < 6)
+    {
+      ret->mnemonic = (DI::Mnemonic) (DI::ADD + (opcode >> 3));
+      size = (opcode & 1) ? 4 : 1;
+
+      switch (opcode & 7)
+        {
+        case 0:
+        case 1:
+          if (!decode_modrm_pair (p, length, &pos, size, false, ret))
+            return false;
+          break;
+
+        case 2:
+        case 3:
+          if (!decode_modrm_pair (p, length, &pos, size, true, ret))
+            return false;
+          break;
+
+        default:
+          set_register (&ret->operands[0], size, 0);
+          if (!set_immediate (&ret->operands[1], size, p, length, &pos,
+                              size))
+            return false;
+          ret->operand_count = 2;
+          break;
+        }
+    }
+  else if (opcode >= 0x40 and opcode < 0x60)
+    {
+      static const DI::Mnemonic mnemonics[] = { DI::INC, DI::DEC,
+                                                DI::PUSH, DI::POP };
+
+      ret->mnemonic = mnemonics[(opcode - 0x40) >> 3];
+      set_register (&ret->operands[0], 4, opcode & 7);
+      ret->operand_count = 1;
+    }
+  else if (opcode == 0x68 or opcode == 0x6a)
+    {
+      ret->mnemonic = DI::PUSH;
+      if (!set_immediate (&ret->operands[0], 4, p, length, &pos,
+                          opcode == 0x68 ? 4 : 1))
+        return false;
+      ret->operand_count = 1;
+    }
+  else if (opcode >= 0x70 and opcode < 0x80)
+    {
+      ret->mnemonic = (DI::Mnemonic) (DI::JO + (opcode & 0xf));
+      if (!set_target (&ret->operands[0], addr, p, length, &pos, 1))
+        return false;
+      ret->operand_count = 1;
+    }
+  else if (opcode == 0x80 or opcode == 0x81 or opcode == 0x83)
+    {
+      size = (opcode == 0x80) ? 1 : 4;
+      if (!decode_modrm (p, length, &pos, size, &ret->operands[0], &reg))
+        return false;
+
+      ret->mnemonic = (DI::Mnemonic) (DI::ADD + reg);
+      if (!set_immediate (&ret->operands[1], size, p, length, &pos,
+                          opcode == 0x81 ? 4 : 1))
+        return false;
+      ret->operand_count = 2;
+      ret->size_suffix   = true;
+    }
+  else if (opcode >= 0x84 and opcode < 0x8c)
+    {
+      static const DI::Mnemonic mnemonics[] = { DI::TEST, DI::XCHG,
+                                                DI::MOV, DI::MOV };
+
+      ret->mnemonic = mnemonics[(opcode - 0x84) >> 1];
+      if (!decode_modrm_pair (p, length, &pos, (opcode & 1) ? 4 : 1,
+                              opcode >= 0x8a, ret))
+        return false;
+    }
+  else if (opcode == 0x8d)
+    {
+      ret->mnemonic = DI::LEA;
+      if (!decode_modrm_pair (p, length, &pos, 4, true, ret))
+        return false;
+
+      if (ret->operands[1].type != Operand::MEMORY)
+        return false;
+    }
+  else if (opcode == 0x90)
+    ret->mnemonic = DI::NOP;
+  else if (opcode >= 0xa0 and opcode < 0xa4)
+    {
+      Operand *moffs;
+
+      if (pos + 4 > length)
+        return false;
+
+      size = (opcode & 1) ? 4 : 1;
+      moffs = &ret->operands[(opcode & 2) ? 0 : 1];
+
+      memset (moffs, 0, sizeof (*moffs));
+      moffs->type         = Operand::OFFSET;
+      moffs->size         = size;
+      moffs->field_offset = pos;
+      moffs->field_size   = 4;
+      moffs->value        = read_le<uint32_t> (p + pos);
+      pos += 4;
+
+      set_register (&ret->operands[(opcode & 2) ? 1 : 0], size, 0);
+      ret->mnemonic = DI::MOV;
+      ret->operand_count = 2;
+    }
+  else if (opcode == 0xa8 or opcode == 0xa9)
+    {
+      size = (opcode & 1) ? 4 : 1;
+      ret->mnemonic = DI::TEST;
+      set_register (&ret->operands[0], size, 0);
+      if (!set_immediate (&ret->operands[1], size, p, length, &pos, size))
+        return false;
+      ret->operand_count = 2;
+    }
+  else if (opcode >= 0xb0 and opcode < 0xc0)
+    {
+      size = (opcode >= 0xb8) ? 4 : 1;
+      ret->mnemonic = DI::MOV;
+      set_register (&ret->operands[0], size, opcode & 7);
+      if (!set_immediate (&ret->operands[1], size, p, length, &pos, size))
+        return false;
+      ret->operand_count = 2;
+    }
+  else if (opcode == 0xc2)
+    {
+      ret->mnemonic = DI::RET;
+      if (!set_immediate (&ret->operands[0], 2, p, length, &pos, 2))
+        return false;
+      ret->operand_count = 1;
+    }
+  else if (opcode == 0xc3)
+    ret->mnemonic = DI::RET;
+  else if (opcode == 0xc6 or opcode == 0xc7)
+    {
+      size = (opcode & 1) ? 4 : 1;
+      if (!decode_modrm (p, length, &pos, size, &ret->operands[0], &reg))
+        return false;
+
+      if (reg != 0)
+        return false;
+
+      ret->mnemonic = DI::MOV;
+      if (!set_immediate (&ret->operands[1], size, p, length, &pos, size))
+        return false;
+      ret->operand_count = 2;
+      ret->size_suffix   = true;
+    }
+  else if (opcode == 0xc9)
+    ret->mnemonic = DI::LEAVE;
+  else if (opcode == 0xcc)
+    ret->mnemonic = DI::INT3;
+  else if (opcode == 0xe8 or opcode == 0xe9 or opcode == 0xeb)
+    {
+      ret->mnemonic = (opcode == 0xe8) ? DI::CALL : DI::JMP;
+      if (!set_target (&ret->operands[0], addr, p, length, &pos,
+                       opcode == 0xeb ? 1 : 4))
+        return false;
+      ret->operand_count = 1;
+    }
+  else if (opcode == 0x0f)
+    {
+      if (pos >= length)
+        return false;
+
+      opcode = p[pos++];
+
+      if (opcode >= 0x80 and opcode < 0x90)
+        {
+          ret->mnemonic = (DI::Mnemonic) (DI::JO + (opcode & 0xf));
+          if (!set_target (&ret->operands[0], addr, p, length, &pos, 4))
+            return false;
+          ret->operand_count = 1;
+        }
+      else if (opcode == 0xb6 or opcode == 0xb7
+               or opcode == 0xbe or opcode == 0xbf)
+        {
+          ret->mnemonic = (opcode < 0xb8) ? DI::MOVZX : DI::MOVSX;
+          if (!decode_modrm (p, length, &pos, (opcode & 1) ? 2 : 1,
+                             &ret->operands[1], &reg))
+            return false;
+
+          set_register (&ret->operands[0], 4, reg);
+          ret->operand_count = 2;
+        }
+      else
+        return false;
+    }
+  else
+    return false;
+
+  ret->size = pos;
+  return true;
+}
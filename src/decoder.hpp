@@ -0,0 +1,73 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file decoder.hpp
+ *     Header file for decoder.cpp, with declaration of decoded instruction
+ *     records.
+ * @par Purpose:
+ *     Declares operand and instruction records produced by the native
+ *     decoder of common i386 instructions, which allows formatting
+ *     the instruction text without going through the disassembler library.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#ifndef LEDISASM_DECODER_H
+#define LEDISASM_DECODER_H
+
+#include <inttypes.h>
+#include <cstddef>
+
+struct Operand
+{
+  enum Type
+  {
+    NONE,
+    REGISTER,   /* value is register number */
+    IMMEDIATE,  /* value is the immediate, already extended to size */
+    MEMORY,     /* ModR/M memory reference, value is displacement */
+    OFFSET,     /* moffs of mov, value is the address */
+    TARGET      /* relative branch, value is the target address */
+  };
+
+  Type     type;
+  uint8_t  size;          /* operand size in bytes */
+  int8_t   base;          /* MEMORY: base register, or -1 */
+  int8_t   index;         /* MEMORY: index register (4 is %eiz), or -1 */
+  uint8_t  scale;         /* MEMORY: log2 of the index scale */
+  uint8_t  disp_size;     /* MEMORY: displacement bytes, 0, 1 or 4 */
+  bool     sib;           /* MEMORY: encoded with a SIB byte */
+  uint8_t  field_offset;  /* position of value bytes within instruction */
+  uint8_t  field_size;    /* size of value bytes, 0 if not encoded */
+  uint8_t  hole;          /* if non-zero, formatted as this marker char */
+  uint32_t value;
+};
+
+struct DecodedInstruction
+{
+  enum Mnemonic
+  {
+    ADD, OR, ADC, SBB, AND, SUB, XOR, CMP,
+    JO, JNO, JB, JAE, JE, JNE, JBE, JA,
+    JS, JNS, JP, JNP, JL, JGE, JLE, JG,
+    MOV, MOVZX, MOVSX, LEA, TEST, XCHG,
+    PUSH, POP, INC, DEC,
+    NOP, RET, LEAVE, INT3, CALL, JMP,
+    MNEMONIC_COUNT
+  };
+
+  Mnemonic mnemonic;
+  uint8_t  size;           /* instruction length in bytes */
+  uint8_t  operand_count;
+  bool     size_suffix;    /* AT&T needs suffix unless register operand */
+  Operand  operands[2];    /* destination first */
+};
+
+bool decode_instruction (uint32_t addr, const void *data, size_t length,
+                         DecodedInstruction *ret);
+
+#endif // LEDISASM_DECODER_H
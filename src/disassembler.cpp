@@ -18,9 +18,11 @@
 #include <cassert>
 #include <cctype>
 #include <cstdarg>
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
 
+#include "decoder.hpp"
 #include "disassembler.hpp"
 #include "instruction.hpp"
 #include "util.hpp"
@@ -60,8 +62,11 @@ struct DisassemblerContext
   std::ostringstream string;
 };
 
+/* Disassembler library is not known to be thread safe */
+static std::mutex library_lock;
 
-Disassembler::Disassembler (void)
+
+Disassembler::Disassembler (AsmSyntax syntax)
 {
   this->info = new disassemble_info;
 
@@ -75,21 +80,37 @@ Disassembler::Disassembler (void)
 
   this->info->arch               = bfd_arch_i386;
   this->info->mach               = bfd_mach_i386_i386;
-  //this->info->disassembler_options = "intel-mnemonic"; // for intel syntax
   this->info->print_address_func = &Disassembler::print_address;
   //disassemble_init_for_target(this->info); // is this really needed?
   this->print_insn = disassembler(this->info->arch, false, this->info->mach, NULL);
+
+  this->syntax = syntax;
+  if (syntax == SYNTAX_INTEL)
+    {
+      this->info->disassembler_options = "intel-mnemonic";
+      this->format_native = &InstructionFormatter<SYNTAX_INTEL>::format;
+    }
+  else
+    this->format_native = &InstructionFormatter<SYNTAX_ATT>::format;
 }
 
 Disassembler::Disassembler (const Disassembler &other)
 {
+  this->info = NULL;
   *this = other;
 }
 
 Disassembler &
 Disassembler::operator= (const Disassembler &other)
 {
-  this->info = new disassemble_info (*other.info);
+  if (this == &other)
+    return *this;
+
+  delete this->info;
+  this->info          = new disassemble_info (*other.info);
+  this->print_insn    = other.print_insn;
+  this->syntax        = other.syntax;
+  this->format_native = other.format_native;
   return *this;
 }
 
@@ -98,6 +119,18 @@ Disassembler::~Disassembler (void)
   delete this->info;
 }
 
+AsmSyntax
+Disassembler::get_syntax (void) const
+{
+  return this->syntax;
+}
+
+void
+Disassembler::format (const DecodedInstruction *inst, std::string *out) const
+{
+  this->format_native (inst, out);
+}
+
 Instruction
 Disassembler::disassemble (uint32_t addr, const std::string &data)
 {
@@ -111,21 +144,35 @@ void
 Disassembler::disassemble (uint32_t addr, const void *data, size_t length,
                            Instruction *inst)
 {
+  DecodedInstruction decoded;
   DisassemblerContext context;
   int size;
 
   assert (length > 0);
 
-  this->info->buffer        = (bfd_byte *) data;
-  this->info->buffer_length = length;
-  this->info->buffer_vma    = addr;
-  this->info->stream        = &context;
+  if (decode_instruction (addr, data, length, &decoded))
+    {
+      inst->string.clear ();
+      this->format_native (&decoded, &inst->string);
+      size = decoded.size;
+    }
+  else
+    {
+      this->info->buffer        = (bfd_byte *) data;
+      this->info->buffer_length = length;
+      this->info->buffer_vma    = addr;
+      this->info->stream        = &context;
+
+      {
+        std::lock_guard<std::mutex> guard (library_lock);
+        size = this->print_insn (addr, this->info);
+      }
+      if (size < 0)
+        throw std::runtime_error ("Failed to disassemble instruction");
 
-  size = this->print_insn (addr, this->info);
-  if (size < 0)
-    throw std::runtime_error ("Failed to disassemble instruction");
+      inst->string = lower (strip (context.string.str ()));
+    }
 
-  inst->string = lower (strip (context.string.str ()));
   inst->size   = size;
   inst->type   = Instruction::MISC;
   inst->target = 0;
@@ -136,6 +183,56 @@ Disassembler::disassemble (uint32_t addr, const void *data, size_t length,
   set_target_and_type(addr, data, inst);
 }
 
+/** Finds the displacement of a relative branch and returns its size.
+ *
+ * For a relative jump or call, stores its target and the offset and size
+ * of its displacement within the instruction. For any other instruction
+ * the size of the displacement is zero.
+ */
+size_t
+Disassembler::find_branch_field (uint32_t addr, const void *data,
+                                 size_t length, uint32_t *target,
+                                 uint32_t *field_offset, uint32_t *field_size)
+{
+  DecodedInstruction decoded;
+  Instruction inst;
+  size_t n;
+
+  *target       = 0;
+  *field_offset = 0;
+  *field_size   = 0;
+
+  if (decode_instruction (addr, data, length, &decoded))
+    {
+      for (n = 0; n < decoded.operand_count; n++)
+        {
+          if (decoded.operands[n].type == Operand::TARGET)
+            {
+              *target       = decoded.operands[n].value;
+              *field_offset = decoded.operands[n].field_offset;
+              *field_size   = decoded.operands[n].field_size;
+            }
+        }
+
+      return decoded.size;
+    }
+
+  this->disassemble (addr, data, length, &inst);
+
+  /* Displacement is at the end, as set_target_and_type reads it */
+  if ((inst.get_type () == Instruction::COND_JUMP
+       or inst.get_type () == Instruction::JUMP
+       or inst.get_type () == Instruction::CALL)
+      and inst.get_target () != 0)
+    {
+      *target       = inst.get_target ();
+      *field_size   = (inst.get_size () < 5 ? 1 : 4);
+      *field_offset = inst.get_size () - *field_size;
+    }
+
+  return inst.get_size ();
+}
+
 void
 Disassembler::set_target_and_type(uint32_t addr, const void *data, Instruction *inst)
 {
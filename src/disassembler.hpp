@@ -24,7 +24,10 @@
 #include "config.h"
 #include "dis-asm.h"
 
+#include "formatter.hpp"
+
 struct disassemble_info;
+struct DecodedInstruction;
 class Instruction;
 
 class Disassembler
@@ -32,6 +35,8 @@ class Disassembler
 protected:
   disassemble_info *info;
   disassembler_ftype print_insn;
+  AsmSyntax syntax;
+  InstructionFormatFunc format_native;
 
 protected:
   static int receive_instruction_text (void *context, const char *fmt, ...);
@@ -44,13 +49,18 @@ protected:
       Instruction *inst);
   
 public:
-  Disassembler (void);
+  Disassembler (AsmSyntax syntax = SYNTAX_ATT);
   Disassembler (const Disassembler &other);
   ~Disassembler (void);
   Disassembler &operator= (const Disassembler &other);
+  AsmSyntax get_syntax (void) const;
+  void format (const DecodedInstruction *inst, std::string *out) const;
   Instruction disassemble (uint32_t addr, const std::string &data);
   void disassemble (uint32_t addr, const void *data, size_t length,
                     Instruction *ret);
+  size_t find_branch_field (uint32_t addr, const void *data, size_t length,
+                            uint32_t *target, uint32_t *field_offset,
+                            uint32_t *field_size);
 };
 
 #endif // LEDISASM_DISASSEMBLER_H
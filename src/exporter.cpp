@@ -0,0 +1,416 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file exporter.cpp
+ *     Implementation of Exporter class.
+ * @par Purpose:
+ *     Implements writing of objects, regions, labels, fixups and decoded
+ *     instructions as JSON Lines or binary records.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#include <cstdio>
+#include <cstring>
+
+#include "exporter.hpp"
+#include "analyser.hpp"
+#include "data_type_table.hpp"
+#include "decoder.hpp"
+#include "disassembler.hpp"
+#include "instruction.hpp"
+#include "label.hpp"
+#include "output_sink.hpp"
+#include "util.hpp"
+
+static const char magic[4] = { 'L', 'E', 'D', 'X' };
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static const char *const record_names[] = {
+  "end", "header", "object", "region", "data", "label", "fixup",
+  "instruction"
+};
+
+static const char *
+get_label_type_name (Label::Type type)
+{
+  switch (type)
+    {
+    case Label::FUNCTION: return "function";
+    case Label::JUMP:     return "jump";
+    case Label::DATA:     return "data";
+    case Label::VTABLE:   return "vtable";
+    default:              return "unknown";
+    }
+}
+
+Exporter::Exporter (OutputSink *out, Format format)
+{
+  this->out    = out;
+  this->format = format;
+}
+
+const char *
+Exporter::get_type_name (Region::Type type)
+{
+  switch (type)
+    {
+    case Region::CODE:          return "code";
+    case Region::DATA:          return "data";
+    case Region::VTABLE:        return "vtable";
+    case Region::POINTER:       return "pointer";
+    case Region::POINTER_ARRAY: return "pointer_array";
+    case Region::ZERO_FILL:     return "zero_fill";
+    case Region::C_STRING:      return "c_string";
+    case Region::ASCII:         return "ascii";
+    case Region::FLOAT_TABLE:   return "float_table";
+    case Region::DOUBLE_TABLE:  return "double_table";
+    case Region::INT16_TABLE:   return "int16_table";
+    case Region::INT32_TABLE:   return "int32_table";
+    case Region::BYTES:         return "bytes";
+    default:                    return "unknown";
+    }
+}
+
+void
+Exporter::begin (Record rec)
+{
+  if (this->format == BINARY)
+    {
+      this->out->put ((char) rec);
+      return;
+    }
+
+  this->out->write ("{\"type\":\"");
+  this->out->write (record_names[rec]);
+  this->out->put ('"');
+}
+
+void
+Exporter::end (void)
+{
+  if (this->format == JSON_LINES)
+    this->out->write ("}\n", 2);
+}
+
+void
+Exporter::field_name (const char *name)
+{
+  /* The type always comes first */
+  this->out->write (",\"", 2);
+  this->out->write (name);
+  this->out->write ("\":", 2);
+}
+
+void
+Exporter::field_u32 (const char *name, uint32_t value)
+{
+  uint8_t buffer[4];
+
+  if (this->format == BINARY)
+    {
+      write_le<uint32_t> (buffer, value);
+      this->out->write ((const char *) buffer, sizeof (buffer));
+      return;
+    }
+
+  this->field_name (name);
+  this->out->write_dec (value);
+}
+
+void
+Exporter::field_bool (const char *name, bool value)
+{
+  if (this->format == BINARY)
+    {
+      this->out->put (value ? 1 : 0);
+      return;
+    }
+
+  this->field_name (name);
+  this->out->write (value ? "true" : "false");
+}
+
+void
+Exporter::field_string (const char *name, const char *str, size_t len)
+{
+  size_t start;
+  size_t n;
+  uint8_t c;
+
+  if (this->format == BINARY)
+    {
+      this->field_u32 (name, len);
+      this->out->write (str, len);
+      return;
+    }
+
+  this->field_name (name);
+  this->out->put ('"');
+
+  start = 0;
+
+  for (n = 0; n < len; n++)
+    {
+      c = str[n];
+      if (c >= 0x20 and c < 0x7f and c != '"' and c != '\\')
+        continue;
+
+      this->out->write (str + start, n - start);
+
+      if (c == '"' or c == '\\')
+        {
+          this->out->put ('\\');
+          this->out->put (c);
+        }
+      else
+        {
+          this->out->write ("\\u00", 4);
+          this->out->put (hex_digits[c >> 4]);
+          this->out->put (hex_digits[c & 0xf]);
+        }
+
+      start = n + 1;
+    }
+
+  this->out->write (str + start, len - start);
+  this->out->put ('"');
+}
+
+void
+Exporter::field_string (const char *name, const std::string &str)
+{
+  this->field_string (name, str.data (), str.size ());
+}
+
+void
+Exporter::field_bytes (const char *name, const uint8_t *data, size_t len)
+{
+  size_t n;
+
+  if (this->format == BINARY)
+    {
+      this->out->put ((char) len);
+      this->out->write ((const char *) data, len);
+      return;
+    }
+
+  this->field_name (name);
+  this->out->put ('"');
+
+  for (n = 0; n < len; n++)
+    {
+      this->out->put (hex_digits[data[n] >> 4]);
+      this->out->put (hex_digits[data[n] & 0xf]);
+    }
+
+  this->out->put ('"');
+}
+
+void
+Exporter::write_labels (const Analyser *anal)
+{
+  const Analyser::LabelMap *labels;
+  const Label *lab;
+  char name[32];
+  size_t n;
+
+  labels = anal->get_labels ();
+
+  for (n = 0; n < labels->size (); n++)
+    {
+      lab = &labels->get_sorted (n);
+
+      this->begin (LABEL);
+      this->field_u32 ("address", lab->get_address ());
+      this->field_string ("kind", get_label_type_name (lab->get_type ()));
+
+      if (lab->has_name ())
+        this->field_string ("name", lab->get_name ());
+      else
+        {
+          snprintf (name, sizeof (name), "%s_%x", lab->get_prefix (),
+                    lab->get_address ());
+          this->field_string ("name", name);
+        }
+
+      this->end ();
+    }
+}
+
+/** Writes every fixup as its address and the address it points to.
+ */
+void
+Exporter::write_fixups (const LinearExecutable *le, const Image *img)
+{
+  const Image::Object *obj;
+  const LEFM *fixups;
+  LEFM::const_iterator itr;
+  size_t n;
+
+  for (n = 0; n < img->get_object_count (); n++)
+    {
+      obj = img->get_object (n);
+      fixups = le->get_fixups_for_object (obj->get_index ());
+
+      for (itr = fixups->begin (); itr != fixups->end (); ++itr)
+        {
+          this->begin (FIXUP);
+          this->field_u32 ("address", obj->get_base_address () + itr->first);
+          this->field_u32 ("target", itr->second.address);
+          this->end ();
+        }
+    }
+}
+
+/** Writes instructions of a code region, decoded the way the printer
+ * decodes them, with addresses left as numbers.
+ */
+void
+Exporter::write_code (const Region *reg, const Image *img,
+                      Disassembler *disasm)
+{
+  const Image::Object *obj;
+  DecodedInstruction decoded;
+  Instruction inst;
+  std::string text;
+  const uint8_t *data;
+  uint32_t addr;
+  uint32_t target;
+  size_t size;
+  size_t n;
+  bool has_target;
+
+  obj = img->get_object_at_address (reg->get_address ());
+  addr = reg->get_address ();
+
+  while (addr < reg->get_end_address ())
+    {
+      data = obj->get_data_at (addr);
+      has_target = false;
+      target = 0;
+
+      if (decode_instruction (addr, data, reg->get_end_address () - addr,
+                              &decoded))
+        {
+          text.clear ();
+          disasm->format (&decoded, &text);
+          size = decoded.size;
+
+          for (n = 0; n < decoded.operand_count; n++)
+            {
+              if (decoded.operands[n].type == Operand::TARGET)
+                {
+                  has_target = true;
+                  target = decoded.operands[n].value;
+                }
+            }
+        }
+      else
+        {
+          disasm->disassemble (addr, data, reg->get_end_address () - addr,
+                               &inst);
+          text = inst.get_string ();
+          size = inst.get_size ();
+
+          if (inst.get_type () != Instruction::MISC
+              and inst.get_type () != Instruction::RET)
+            {
+              has_target = true;
+              target = inst.get_target ();
+            }
+        }
+
+      /* Never stall on bytes the disassembler could not make out */
+      if (size == 0)
+        size = 1;
+
+      this->begin (INSTRUCTION);
+      this->field_u32 ("address", addr);
+      this->field_bytes ("bytes", data, size);
+      this->field_string ("text", text);
+      this->field_bool ("has_target", has_target);
+      this->field_u32 ("target", target);
+      this->end ();
+
+      addr += size;
+    }
+}
+
+void
+Exporter::write_data (const Region *reg, const Analyser *anal)
+{
+  const Region *typed;
+  size_t count;
+  size_t n;
+
+  typed = anal->get_data_types ()->find_within (reg, &count);
+
+  for (n = 0; n < count; n++)
+    {
+      this->begin (DATA);
+      this->field_u32 ("address", typed[n].get_address ());
+      this->field_u32 ("size", typed[n].get_size ());
+      this->field_string ("kind", get_type_name (typed[n].get_type ()));
+      this->end ();
+    }
+}
+
+/** Writes the whole analysis.
+ */
+void
+Exporter::write (const LinearExecutable *le, const Image *img,
+                 const Analyser *anal, Disassembler *disasm)
+{
+  const Analyser::RegionMap *regions;
+  Analyser::RegionMap::const_iterator itr;
+  const Image::Object *obj;
+  size_t n;
+
+  if (this->format == BINARY)
+    this->out->write (magic, sizeof (magic));
+
+  this->begin (HEADER);
+  this->field_u32 ("version", FORMAT_VERSION);
+  this->field_u32 ("objects", img->get_object_count ());
+  this->end ();
+
+  for (n = 0; n < img->get_object_count (); n++)
+    {
+      obj = img->get_object (n);
+
+      this->begin (OBJECT);
+      this->field_u32 ("index", obj->get_index ());
+      this->field_u32 ("address", obj->get_base_address ());
+      this->field_u32 ("size", obj->get_data ()->size ());
+      this->field_bool ("executable", obj->is_executable ());
+      this->end ();
+    }
+
+  this->write_labels (anal);
+  this->write_fixups (le, img);
+
+  regions = anal->get_regions ();
+
+  for (itr = regions->begin (); itr != regions->end (); ++itr)
+    {
+      this->begin (REGION);
+      this->field_u32 ("address", itr->get_address ());
+      this->field_u32 ("size", itr->get_size ());
+      this->field_string ("kind", get_type_name (itr->get_type ()));
+      this->end ();
+
+      if (itr->get_type () == Region::CODE)
+        this->write_code (&*itr, img, disasm);
+      else if (itr->get_type () == Region::DATA)
+        this->write_data (&*itr, anal);
+    }
+
+  this->begin (END);
+  this->end ();
+}
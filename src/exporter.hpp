@@ -0,0 +1,102 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file exporter.hpp
+ *     Header file for exporter.cpp, with declaration of Exporter class.
+ * @par Purpose:
+ *     Storage for Exporter class which writes the analysis as a stream
+ *     of records, for use by other tools.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#ifndef LEDISASM_EXPORTER_H
+#define LEDISASM_EXPORTER_H
+
+#include <inttypes.h>
+#include <cstddef>
+#include <string>
+
+#include "image.hpp"
+#include "le.hpp"
+#include "regions.hpp"
+
+class Analyser;
+class Disassembler;
+class OutputSink;
+
+/** Writer of the analysis as records, without the assembly printer.
+ *
+ * Records come in this order: header, objects, labels, fixups, then
+ * regions in address order, each followed by its instructions or typed
+ * data, and end. Every record is written once complete, so a reader can
+ * process the stream while it is being written.
+ *
+ * In JSON Lines format every record is an object on a line of its own,
+ * with its kind in "type" and numbers written in decimal. In binary
+ * format the stream starts with "LEDX", then every record is its kind
+ * as a byte followed by its fields in the order they are written in:
+ * numbers as 32-bit little endian, flags as a byte, strings as 32-bit
+ * length and the characters, and bytes of an instruction as 8-bit length
+ * and the bytes.
+ */
+class Exporter
+{
+public:
+  enum Format
+  {
+    JSON_LINES,
+    BINARY
+  };
+
+  enum Record
+  {
+    END,
+    HEADER,
+    OBJECT,
+    REGION,
+    DATA,
+    LABEL,
+    FIXUP,
+    INSTRUCTION
+  };
+
+  enum
+  {
+    FORMAT_VERSION = 1
+  };
+
+protected:
+  OutputSink *out;
+  Format      format;
+
+protected:
+  void begin (Record rec);
+  void end (void);
+  void field_name (const char *name);
+  void field_u32 (const char *name, uint32_t value);
+  void field_bool (const char *name, bool value);
+  void field_string (const char *name, const char *str, size_t len);
+  void field_string (const char *name, const std::string &str);
+  void field_bytes (const char *name, const uint8_t *data, size_t len);
+
+  void write_labels (const Analyser *anal);
+  void write_fixups (const LinearExecutable *le, const Image *img);
+  void write_code (const Region *reg, const Image *img,
+                   Disassembler *disasm);
+  void write_data (const Region *reg, const Analyser *anal);
+
+public:
+  Exporter (OutputSink *out, Format format);
+
+  void write (const LinearExecutable *le, const Image *img,
+              const Analyser *anal, Disassembler *disasm);
+
+  static const char *get_type_name (Region::Type type);
+};
+
+#endif // LEDISASM_EXPORTER_H
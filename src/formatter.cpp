@@ -0,0 +1,303 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file formatter.cpp
+ *     Implementation of InstructionFormatter template.
+ * @par Purpose:
+ *     Implements formatting of decoded instruction records into AT&T
+ *     or Intel syntax text, matching the text produced by libopcodes.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#include "formatter.hpp"
+#include "decoder.hpp"
+
+typedef DecodedInstruction DI;
+
+static const char *const mnemonic_names[DI::MNEMONIC_COUNT] =
+{
+  "add", "or", "adc", "sbb", "and", "sub", "xor", "cmp",
+  "jo", "jno", "jb", "jae", "je", "jne", "jbe", "ja",
+  "js", "jns", "jp", "jnp", "jl", "jge", "jle", "jg",
+  "mov", "movzx", "movsx", "lea", "test", "xchg",
+  "push", "pop", "inc", "dec",
+  "nop", "ret", "leave", "int3", "call", "jmp"
+};
+
+static const char *const register_names[3][8] =
+{
+  { "al", "cl", "dl", "bl", "ah", "ch", "dh", "bh" },
+  { "ax", "cx", "dx", "bx", "sp", "bp", "si", "di" },
+  { "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi" }
+};
+
+static char
+size_suffix (uint8_t size)
+{
+  switch (size)
+    {
+    case 1:  return 'b';
+    case 2:  return 'w';
+    default: return 'l';
+    }
+}
+
+static const char *
+size_keyword (uint8_t size)
+{
+  switch (size)
+    {
+    case 1:  return "byte ptr ";
+    case 2:  return "word ptr ";
+    default: return "dword ptr ";
+    }
+}
+
+void
+append_hex (std::string *out, uint32_t value)
+{
+  static const char digits[] = "0123456789abcdef";
+  char buffer[8];
+  int n = 0;
+
+  do
+    {
+      buffer[n++] = digits[value & 0xf];
+      value >>= 4;
+    }
+  while (value != 0);
+
+  out->append ("0x", 2);
+
+  while (n > 0)
+    out->push_back (buffer[--n]);
+}
+
+void
+append_signed_hex (std::string *out, int32_t value)
+{
+  if (value < 0)
+    {
+      out->push_back ('-');
+      append_hex (out, (uint32_t) -(int64_t) value);
+    }
+  else
+    append_hex (out, value);
+}
+
+/** Appends the numeric part of an operand, or its hole marker.
+ */
+void
+append_operand_value (std::string *out, const Operand *op)
+{
+  if (op->hole != 0)
+    out->push_back (op->hole);
+  else if (op->type == Operand::MEMORY and (op->sib or op->base >= 0))
+    append_signed_hex (out, op->value);
+  else
+    append_hex (out, op->value);
+}
+
+template <AsmSyntax S>
+void
+InstructionFormatter<S>::append_register (std::string *out, uint8_t size,
+                                          unsigned int reg)
+{
+  if (S == SYNTAX_ATT)
+    out->push_back ('%');
+
+  out->append (register_names[size == 1 ? 0 : (size == 2 ? 1 : 2)][reg]);
+}
+
+template <AsmSyntax S>
+void
+InstructionFormatter<S>::append_memory (std::string *out, const Operand *op,
+                                        bool with_size)
+{
+  bool havebase;
+  bool haveindex;
+  bool needindex;
+  bool printindex;
+  bool printed;
+
+  if (S == SYNTAX_INTEL and with_size)
+    out->append (size_keyword (op->size));
+
+  if (!op->sib and op->base < 0)
+    {
+      if (S == SYNTAX_INTEL)
+        out->append ("ds:", 3);
+
+      append_operand_value (out, op);
+      return;
+    }
+
+  havebase   = (op->base >= 0);
+  haveindex  = (op->sib and op->index != 4);
+  needindex  = (op->sib and !havebase and !haveindex);
+  printindex = (op->sib and (op->scale != 0 or needindex or haveindex
+                             or (havebase and op->base != 4)));
+
+  if (S == SYNTAX_ATT)
+    {
+      if (op->disp_size != 0)
+        append_operand_value (out, op);
+
+      out->push_back ('(');
+
+      if (havebase)
+        append_register (out, 4, op->base);
+
+      if (printindex)
+        {
+          out->push_back (',');
+
+          if (haveindex)
+            append_register (out, 4, op->index);
+          else
+            out->append ("%eiz", 4);
+
+          out->push_back (',');
+          out->push_back ('0' + (1 << op->scale));
+        }
+
+      out->push_back (')');
+    }
+  else
+    {
+      printed = false;
+      out->push_back ('[');
+
+      if (havebase)
+        {
+          append_register (out, 4, op->base);
+          printed = true;
+        }
+
+      if (printindex)
+        {
+          if (printed)
+            out->push_back ('+');
+
+          if (haveindex)
+            append_register (out, 4, op->index);
+          else
+            out->append ("eiz", 3);
+
+          out->push_back ('*');
+          out->push_back ('0' + (1 << op->scale));
+          printed = true;
+        }
+
+      if (op->disp_size != 0)
+        {
+          if (op->hole != 0 and printed)
+            out->push_back (op->hole | OPERAND_HOLE_PLUS);
+          else
+            {
+              if ((int32_t) op->value >= 0 and printed)
+                out->push_back ('+');
+
+              append_operand_value (out, op);
+            }
+        }
+
+      out->push_back (']');
+    }
+}
+
+template <AsmSyntax S>
+void
+InstructionFormatter<S>::append_operand (std::string *out, const Operand *op,
+                                         bool with_size)
+{
+  switch (op->type)
+    {
+    case Operand::REGISTER:
+      append_register (out, op->size, op->value);
+      break;
+
+    case Operand::IMMEDIATE:
+      if (S == SYNTAX_ATT)
+        out->push_back ('$');
+
+      append_operand_value (out, op);
+      break;
+
+    case Operand::MEMORY:
+      append_memory (out, op, with_size);
+      break;
+
+    case Operand::OFFSET:
+      if (S == SYNTAX_INTEL)
+        out->append ("ds:", 3);
+
+      append_operand_value (out, op);
+      break;
+
+    case Operand::TARGET:
+      append_operand_value (out, op);
+      break;
+
+    default:
+      break;
+    }
+}
+
+template <AsmSyntax S>
+void
+InstructionFormatter<S>::format (const DecodedInstruction *inst,
+                                 std::string *out)
+{
+  size_t start;
+  size_t n;
+  bool with_size;
+
+  start = out->size ();
+
+  if (S == SYNTAX_ATT
+      and (inst->mnemonic == DI::MOVZX or inst->mnemonic == DI::MOVSX))
+    {
+      out->append (inst->mnemonic == DI::MOVZX ? "movz" : "movs", 4);
+      out->push_back (size_suffix (inst->operands[1].size));
+      out->push_back ('l');
+    }
+  else
+    {
+      out->append (mnemonic_names[inst->mnemonic]);
+
+      if (S == SYNTAX_ATT and inst->size_suffix
+          and inst->operands[0].type != Operand::REGISTER)
+        out->push_back (size_suffix (inst->operands[0].size));
+    }
+
+  if (inst->operand_count == 0)
+    return;
+
+  while (out->size () - start < 6)
+    out->push_back (' ');
+
+  out->push_back (' ');
+
+  with_size = (inst->mnemonic != DI::LEA);
+
+  for (n = 0; n < inst->operand_count; n++)
+    {
+      if (n > 0)
+        out->push_back (',');
+
+      if (S == SYNTAX_ATT)
+        append_operand (out, &inst->operands[inst->operand_count - 1 - n],
+                        with_size);
+      else
+        append_operand (out, &inst->operands[n], with_size);
+    }
+}
+
+template class InstructionFormatter<SYNTAX_ATT>;
+template class InstructionFormatter<SYNTAX_INTEL>;
@@ -0,0 +1,63 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file formatter.hpp
+ *     Header file for formatter.cpp, with declaration of InstructionFormatter.
+ * @par Purpose:
+ *     Storage for InstructionFormatter template which turns decoded
+ *     instruction records into text, specialised on assembly syntax.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#ifndef LEDISASM_FORMATTER_H
+#define LEDISASM_FORMATTER_H
+
+#include <inttypes.h>
+#include <string>
+
+struct DecodedInstruction;
+struct Operand;
+
+enum AsmSyntax
+{
+  SYNTAX_ATT,
+  SYNTAX_INTEL
+};
+
+/** Formats decoded instructions the same way libopcodes would.
+ *
+ * Text is appended directly to the output string, lowercase and with
+ * the mnemonic padded, so it can be mixed with text received from
+ * the disassembler library.
+ */
+template <AsmSyntax S>
+class InstructionFormatter
+{
+protected:
+  static void append_register (std::string *out, uint8_t size,
+                               unsigned int reg);
+  static void append_memory (std::string *out, const Operand *op,
+                             bool with_size);
+  static void append_operand (std::string *out, const Operand *op,
+                              bool with_size);
+
+public:
+  static void format (const DecodedInstruction *inst, std::string *out);
+};
+
+/* Set in a hole marker when a non-negative value needs a '+' before it. */
+#define OPERAND_HOLE_PLUS 0x10
+
+typedef void (*InstructionFormatFunc) (const DecodedInstruction *inst,
+                                       std::string *out);
+
+void append_hex (std::string *out, uint32_t value);
+void append_signed_hex (std::string *out, int32_t value);
+void append_operand_value (std::string *out, const Operand *op);
+
+#endif // LEDISASM_FORMATTER_H
@@ -0,0 +1,486 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file function_diff.cpp
+ *     Implementation of FunctionDiff class.
+ * @par Purpose:
+ *     Implements fingerprinting of functions by hashes of their normalised
+ *     instructions, and matching of the functions between two versions.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+#include "function_diff.hpp"
+#include "analyser.hpp"
+#include "cfg.hpp"
+#include "disassembler.hpp"
+#include "label.hpp"
+#include "output_sink.hpp"
+#include "util.hpp"
+
+static const size_t NO_PARTNER = (size_t) -1;
+
+/* Bytes changed by a relocation */
+static const uint32_t fixup_size = 4;
+
+/* Hashed instead of the target of a branch leaving the function */
+static const uint32_t outside_target = 0xffffffff;
+
+/* Width of the change column of the report */
+static const size_t change_width = 9;
+
+/** Returns hash of the instructions of a function.
+ *
+ * Blocks of the function are hashed in address order. Relocated bytes
+ * and displacements of relative branches are hashed as zeros, and each
+ * branch is followed by the place of its target among the blocks of the
+ * function, or by a marker if it leaves the function.
+ */
+uint64_t
+FunctionDiff::fingerprint (const ControlFlowGraph *cfg, size_t function,
+                           const LinearExecutable *le, const Image *img,
+                           Disassembler *disasm)
+{
+  const ControlFlowGraph::Block *block;
+  const uint32_t *members;
+  const Image::Object *obj;
+  const LEFM *fixups;
+  LEFM::const_iterator itr;
+  std::vector<uint8_t> mask;
+  const uint8_t *data;
+  uint8_t bytes[16];
+  uint8_t target_bytes[8];
+  uint64_t hash;
+  uint32_t offset;
+  uint32_t size;
+  uint32_t pos;
+  uint32_t len;
+  uint32_t target;
+  uint32_t disp_offset;
+  uint32_t disp_size;
+  size_t count;
+  size_t index;
+  size_t b;
+  size_t n;
+
+  members = cfg->get_function_blocks (function, &count);
+  hash    = fnv1a_offset_basis;
+
+  for (b = 0; b < count; b++)
+    {
+      block  = cfg->get_block (members[b]);
+      obj    = img->get_object_at_address (block->start);
+      fixups = le->get_fixups_for_object (obj->get_index ());
+      offset = block->start - obj->get_base_address ();
+      size   = block->end - block->start;
+
+      mask.assign (size, 1);
+
+      itr = fixups->lower_bound (offset < fixup_size
+                                 ? 0 : offset - fixup_size + 1);
+
+      for (; itr != fixups->end () and itr->first < offset + size; ++itr)
+        {
+          for (n = itr->first; n < itr->first + fixup_size; n++)
+            {
+              if (n >= offset and n < offset + size)
+                mask[n - offset] = 0;
+            }
+        }
+
+      for (pos = block->start; pos < block->end; pos += len)
+        {
+          data = obj->get_data_at (pos);
+          len  = disasm->find_branch_field (pos, data, block->end - pos,
+                                            &target, &disp_offset,
+                                            &disp_size);
+
+          /* Never stall on bytes the disassembler could not make out */
+          len = std::min<uint32_t> (std::max<uint32_t> (len, 1),
+                                    block->end - pos);
+          len = std::min<uint32_t> (len, sizeof (bytes));
+
+          for (n = 0; n < len; n++)
+            bytes[n] = (mask[pos - block->start + n] != 0 ? data[n] : 0);
+
+          for (n = disp_offset; n < disp_offset + disp_size and n < len; n++)
+            bytes[n] = 0;
+
+          hash = fnv1a_hash (bytes, len, hash);
+
+          if (disp_size == 0)
+            continue;
+
+          index = cfg->find_block (target);
+          if (index < cfg->get_block_count ()
+              and cfg->get_block (index)->function == function)
+            {
+              n = std::lower_bound (members, members + count, index)
+                  - members;
+              write_le<uint32_t> (target_bytes, n);
+              write_le<uint32_t> (target_bytes + 4,
+                                  target - cfg->get_block (index)->start);
+            }
+          else
+            {
+              write_le<uint32_t> (target_bytes, outside_target);
+              write_le<uint32_t> (target_bytes + 4, outside_target);
+            }
+
+          hash = fnv1a_hash (target_bytes, sizeof (target_bytes), hash);
+        }
+    }
+
+  return hash;
+}
+
+/** Fingerprints the functions of one version of the executable.
+ *
+ * Every function is made of its blocks in the control flow graph, so
+ * blocks placed after other functions are part of it, and code of
+ * another function which follows without a label is not.
+ */
+void
+FunctionDiff::add_functions (Version version, const LinearExecutable *le,
+                             const Image *img, const Analyser *anal,
+                             Disassembler *disasm)
+{
+  const ControlFlowGraph *cfg;
+  const ControlFlowGraph::Block *block;
+  const uint32_t *members;
+  const Label *lab;
+  Function func;
+  size_t count;
+  size_t n;
+  size_t m;
+  char name[32];
+
+  cfg = anal->get_cfg ();
+
+  this->functions[version].clear ();
+
+  for (n = 0; n < cfg->get_function_count (); n++)
+    {
+      block = cfg->get_block (cfg->get_function_entry (n));
+      lab   = anal->get_label (block->start);
+
+      func.address = block->start;
+      func.size    = 0;
+
+      members = cfg->get_function_blocks (n, &count);
+      for (m = 0; m < count; m++)
+        {
+          block = cfg->get_block (members[m]);
+          func.size += block->end - block->start;
+        }
+
+      func.hash  = fingerprint (cfg, n, le, img, disasm);
+      func.named = lab->has_name ();
+
+      if (func.named)
+        func.name = lab->get_name ();
+      else
+        {
+          snprintf (name, sizeof (name), "%s_%x", lab->get_prefix (),
+                    func.address);
+          func.name = name;
+        }
+
+      this->functions[version].push_back (func);
+    }
+
+  this->partners[version].assign (this->functions[version].size (),
+                                  NO_PARTNER);
+}
+
+void
+FunctionDiff::pair (size_t old_index, size_t new_index)
+{
+  this->partners[OLD][old_index] = new_index;
+  this->partners[NEW][new_index] = old_index;
+}
+
+/** Pairs functions with equal hashes, at the same address if possible.
+ *
+ * Old functions are chained by hash in address order, and matched ones
+ * are dropped from the head of the chain, so every function is looked at
+ * a bounded number of times.
+ */
+void
+FunctionDiff::match_hashes (void)
+{
+  typedef std::unordered_map<uint64_t, size_t> HeadMap;
+  typedef std::unordered_map<uint32_t, size_t> AddressMap;
+
+  const std::vector<Function> &olds = this->functions[OLD];
+  const std::vector<Function> &news = this->functions[NEW];
+  std::vector<size_t> next (olds.size (), NO_PARTNER);
+  HeadMap heads;
+  HeadMap::iterator head;
+  AddressMap addresses;
+  AddressMap::const_iterator same;
+  size_t n;
+  size_t k;
+
+  heads.reserve (olds.size ());
+  addresses.reserve (olds.size ());
+
+  for (n = olds.size (); n > 0; n--)
+    {
+      head = heads.find (olds[n - 1].hash);
+      if (head == heads.end ())
+        heads.insert (HeadMap::value_type (olds[n - 1].hash, n - 1));
+      else
+        {
+          next[n - 1] = head->second;
+          head->second = n - 1;
+        }
+
+      addresses.insert (AddressMap::value_type (olds[n - 1].address, n - 1));
+    }
+
+  for (n = 0; n < news.size (); n++)
+    {
+      same = addresses.find (news[n].address);
+      if (same != addresses.end () and olds[same->second].hash == news[n].hash)
+        this->pair (same->second, n);
+    }
+
+  for (n = 0; n < news.size (); n++)
+    {
+      if (this->partners[NEW][n] != NO_PARTNER)
+        continue;
+
+      head = heads.find (news[n].hash);
+      if (head == heads.end ())
+        continue;
+
+      k = head->second;
+      while (k != NO_PARTNER and this->partners[OLD][k] != NO_PARTNER)
+        k = next[k];
+
+      if (k == NO_PARTNER)
+        {
+          head->second = NO_PARTNER;
+          continue;
+        }
+
+      this->pair (k, n);
+      head->second = next[k];
+    }
+}
+
+/** Pairs named functions left, which keep their names across versions.
+ */
+void
+FunctionDiff::match_names (void)
+{
+  typedef std::unordered_map<std::string, size_t> NameMap;
+
+  const std::vector<Function> &olds = this->functions[OLD];
+  const std::vector<Function> &news = this->functions[NEW];
+  NameMap names;
+  NameMap::const_iterator itr;
+  size_t n;
+
+  for (n = 0; n < olds.size (); n++)
+    {
+      if (olds[n].named and this->partners[OLD][n] == NO_PARTNER)
+        names.insert (NameMap::value_type (olds[n].name, n));
+    }
+
+  for (n = 0; n < news.size (); n++)
+    {
+      if (!news[n].named or this->partners[NEW][n] != NO_PARTNER)
+        continue;
+
+      itr = names.find (news[n].name);
+      if (itr != names.end () and this->partners[OLD][itr->second] == NO_PARTNER)
+        this->pair (itr->second, n);
+    }
+}
+
+/** Pairs unmatched functions lying between two consecutive matched pairs.
+ */
+void
+FunctionDiff::match_gaps (void)
+{
+  size_t old_begin;
+  size_t new_begin;
+  size_t partner;
+  size_t n;
+
+  old_begin = 0;
+  new_begin = 0;
+
+  for (n = 0; n < this->functions[NEW].size (); n++)
+    {
+      partner = this->partners[NEW][n];
+      if (partner == NO_PARTNER)
+        continue;
+
+      /* A function moved back across others does not end a gap */
+      if (partner >= old_begin)
+        {
+          this->fill_gap (old_begin, partner, new_begin, n);
+          old_begin = partner + 1;
+        }
+
+      new_begin = n + 1;
+    }
+
+  this->fill_gap (old_begin, this->functions[OLD].size (),
+                  new_begin, this->functions[NEW].size ());
+}
+
+void
+FunctionDiff::fill_gap (size_t old_begin, size_t old_end,
+                        size_t new_begin, size_t new_end)
+{
+  size_t n;
+
+  if (old_end - old_begin != new_end - new_begin)
+    return;
+
+  for (n = old_begin; n < old_end; n++)
+    {
+      if (this->partners[OLD][n] != NO_PARTNER)
+        return;
+    }
+
+  for (n = 0; n < old_end - old_begin; n++)
+    this->pair (old_begin + n, new_begin + n);
+}
+
+void
+FunctionDiff::match (void)
+{
+  this->match_hashes ();
+  this->match_names ();
+  this->match_gaps ();
+}
+
+FunctionDiff::Change
+FunctionDiff::get_change (Version version, size_t index) const
+{
+  const Function *func;
+  const Function *other;
+  size_t partner;
+
+  partner = this->partners[version][index];
+  if (partner == NO_PARTNER)
+    return (version == OLD ? REMOVED : ADDED);
+
+  func  = &this->functions[version][index];
+  other = &this->functions[version == OLD ? NEW : OLD][partner];
+
+  if (func->hash != other->hash)
+    return CHANGED;
+
+  return (func->address == other->address ? UNCHANGED : MOVED);
+}
+
+size_t
+FunctionDiff::count (Change change) const
+{
+  Version version;
+  size_t ret;
+  size_t n;
+
+  version = (change == REMOVED ? OLD : NEW);
+  ret = 0;
+
+  for (n = 0; n < this->functions[version].size (); n++)
+    {
+      if (this->get_change (version, n) == change)
+        ret++;
+    }
+
+  return ret;
+}
+
+/** Writes a line for every function which is not unchanged.
+ *
+ * Functions of the new version come first in address order, followed
+ * by functions removed from the old version.
+ */
+void
+FunctionDiff::print (OutputSink *out) const
+{
+  const Function *func;
+  const Function *old;
+  const char *name;
+  Change change;
+  size_t n;
+
+  old = NULL;
+
+  for (n = 0; n < this->functions[NEW].size (); n++)
+    {
+      change = this->get_change (NEW, n);
+      if (change == UNCHANGED)
+        continue;
+
+      func = &this->functions[NEW][n];
+      name = get_change_name (change);
+
+      out->write (name);
+      out->fill (' ', change_width - strlen (name));
+
+      if (change != ADDED)
+        {
+          old = &this->functions[OLD][this->partners[NEW][n]];
+          out->write (old->name);
+          out->write (" -> ");
+        }
+
+      out->write (func->name);
+
+      if (change == CHANGED)
+        {
+          out->write (" (");
+          out->write_dec (old->size);
+          out->write (" -> ");
+          out->write_dec (func->size);
+          out->write (" bytes)");
+        }
+
+      out->put ('\n');
+    }
+
+  for (n = 0; n < this->functions[OLD].size (); n++)
+    {
+      if (this->partners[OLD][n] != NO_PARTNER)
+        continue;
+
+      name = get_change_name (REMOVED);
+
+      out->write (name);
+      out->fill (' ', change_width - strlen (name));
+      out->write (this->functions[OLD][n].name);
+      out->put ('\n');
+    }
+}
+
+const char *
+FunctionDiff::get_change_name (Change change)
+{
+  switch (change)
+    {
+    case UNCHANGED: return "unchanged";
+    case MOVED:     return "moved";
+    case CHANGED:   return "changed";
+    case ADDED:     return "added";
+    case REMOVED:   return "removed";
+    default:        return "unknown";
+    }
+}
@@ -0,0 +1,102 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file function_diff.hpp
+ *     Header file for function_diff.cpp, with declaration of FunctionDiff.
+ * @par Purpose:
+ *     Storage for FunctionDiff class which fingerprints functions of two
+ *     versions of an executable and matches them between the versions.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#ifndef LEDISASM_FUNCTION_DIFF_H
+#define LEDISASM_FUNCTION_DIFF_H
+
+#include <inttypes.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "image.hpp"
+#include "le.hpp"
+
+class Analyser;
+class ControlFlowGraph;
+class Disassembler;
+class OutputSink;
+
+/** Differences between functions of two versions of an executable.
+ *
+ * Every function is fingerprinted with a hash of the instructions of its
+ * blocks in the control flow graph, with relocated bytes left out.
+ * Relative branches within the function are hashed as places among its
+ * blocks, and those leaving it only as such, so the hash does not change
+ * when the function, its blocks or its callees move.
+ *
+ * Functions are matched in passes: the same hash at the same address,
+ * the same hash anywhere, the same name, and at last functions left
+ * between two matched pairs, if there is the same number of them in both
+ * versions. Functions matched by hash are unchanged or moved, the ones
+ * matched otherwise are changed, and the rest are added or removed.
+ */
+class FunctionDiff
+{
+public:
+  enum Version
+  {
+    OLD,
+    NEW
+  };
+
+  enum Change
+  {
+    UNCHANGED,
+    MOVED,
+    CHANGED,
+    ADDED,
+    REMOVED
+  };
+
+protected:
+  struct Function
+  {
+    uint32_t    address;
+    uint32_t    size;
+    uint64_t    hash;
+    std::string name;
+    bool        named;
+  };
+
+  std::vector<Function> functions[2];
+  std::vector<size_t>   partners[2];
+
+protected:
+  static uint64_t fingerprint (const ControlFlowGraph *cfg, size_t function,
+                               const LinearExecutable *le, const Image *img,
+                               Disassembler *disasm);
+
+  void pair (size_t old_index, size_t new_index);
+  void match_hashes (void);
+  void match_names (void);
+  void match_gaps (void);
+  void fill_gap (size_t old_begin, size_t old_end,
+                 size_t new_begin, size_t new_end);
+  Change get_change (Version version, size_t index) const;
+
+public:
+  void add_functions (Version version, const LinearExecutable *le,
+                      const Image *img, const Analyser *anal,
+                      Disassembler *disasm);
+  void match (void);
+  size_t count (Change change) const;
+  void print (OutputSink *out) const;
+
+  static const char *get_change_name (Change change);
+};
+
+#endif // LEDISASM_FUNCTION_DIFF_H
@@ -18,26 +18,23 @@
 #include "label.hpp"
 #include "util.hpp"
 
+StringPool Label::names;
+
 Label::Label (uint32_t address, Label::Type type,
   const std::string &name)
 {
   this->address = address;
-  this->name    = name;
+  this->name_id = name.empty () ? 0 : names.intern (name);
   this->type    = type;
 }
 
 Label::Label (void)
 {
   this->address = 0;
-  this->name    = "";
+  this->name_id = 0;
   this->type    = UNKNOWN;
 }
 
-Label::Label (const Label &other)
-{
-  *this = other;
-}
-
 uint32_t
 Label::get_address (void) const
 {
@@ -50,33 +47,41 @@ Label::get_type (void) const
   return this->type;
 }
 
-std::string
+const std::string &
 Label::get_name (void) const
 {
-  return this->name;
+  return names.get (this->name_id);
 }
 
-std::ostream &
-operator<< (std::ostream &os, const Label &label)
+bool
+Label::has_name (void) const
 {
-  PUSH_IOS_FLAGS (&os);
+  return (this->name_id != 0);
+}
 
-  if (label.get_name ().empty ())
+/** Returns start of the name generated for a label without a name.
+ */
+const char *
+Label::get_prefix (void) const
+{
+  switch (this->type)
     {
-      std::string prefix;
+    case Label::FUNCTION: return "func";
+    case Label::JUMP:     return "jump";
+    case Label::DATA:     return "data";
+    case Label::VTABLE:   return "vtable";
+    default:              return "unknown";
+    }
+}
 
-      switch (label.get_type ())
-        {
-        case Label::FUNCTION: prefix = "func";    break;
-        case Label::JUMP:     prefix = "jump";    break;
-        case Label::DATA:     prefix = "data";    break;
-        case Label::VTABLE:   prefix = "vtable";  break;
-        default:              prefix = "unknown"; break;
-        }
+std::ostream &
+operator<< (std::ostream &os, const Label &label)
+{
+  PUSH_IOS_FLAGS (&os);
 
-      os << prefix << "_" << std::hex << std::noshowbase
-         << label.get_address ();
-    }
+  if (!label.has_name ())
+    os << label.get_prefix () << "_" << std::hex << std::noshowbase
+       << label.get_address ();
   else
     os << label.get_name ();
 
@@ -20,10 +20,15 @@
 #include <inttypes.h>
 #include <string>
 
+#include "string_pool.hpp"
+
 class LinearExecutable;
 class Image;
 class Region;
 
+/** Label is a small plain record; its name is kept in a shared pool
+ * of strings, so copying a label never copies the name.
+ */
 class Label
 {
 public:
@@ -37,19 +42,22 @@ public:
   };
 
 protected:
+  static StringPool names;
+
   uint32_t address;
-  std::string name;
+  uint32_t name_id;
   Label::Type type;
 
 public:
   Label (uint32_t address, Label::Type type = UNKNOWN,
          const std::string &name = "");
   Label (void);
-  Label (const Label &other);
 
   uint32_t  get_address (void) const;
   Label::Type  get_type (void) const;
-  std::string  get_name (void) const;
+  const std::string &get_name (void) const;
+  bool  has_name (void) const;
+  const char *get_prefix (void) const;
 };
 
 std::ostream &operator<< (std::ostream &os, const Label &label);
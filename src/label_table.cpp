@@ -0,0 +1,224 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file label_table.cpp
+ *     Implementation of LabelTable class.
+ * @par Purpose:
+ *     Implements hashed storage of labels with lazily sorted order.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#include <algorithm>
+
+#include "label_table.hpp"
+
+/* Slot value of an unused hash slot */
+static const uint32_t empty_slot = 0xffffffff;
+
+static inline size_t
+hash_address (uint32_t address)
+{
+  return (address * 0x9e3779b1u) >> 7;
+}
+
+LabelTable::Data::Data (void)
+{
+  this->order_valid = true;
+}
+
+/* Returns slot holding given address, or the free slot it would go to. */
+size_t
+LabelTable::find_slot (const Data *data, uint32_t address)
+{
+  size_t mask;
+  size_t n;
+
+  mask = data->slots.size () - 1;
+  n = hash_address (address) & mask;
+
+  while (data->slots[n] != empty_slot
+         and data->labels[data->slots[n]].get_address () != address)
+    n = (n + 1) & mask;
+
+  return n;
+}
+
+void
+LabelTable::grow (Data *data)
+{
+  size_t n;
+
+  data->slots.assign (std::max<size_t> (64, 2 * data->slots.size ()),
+                      empty_slot);
+
+  for (n = 0; n < data->labels.size (); n++)
+    data->slots[find_slot (data, data->labels[n].get_address ())] = n;
+}
+
+void
+LabelTable::update_order (void) const
+{
+  Data *data;
+  size_t n;
+
+  if (this->data->order_valid)
+    return;
+
+  data = this->data.edit ();
+  data->order.resize (data->labels.size ());
+  for (n = 0; n < data->labels.size (); n++)
+    data->order[n] = n;
+
+  std::sort (data->order.begin (), data->order.end (),
+             [data] (uint32_t a, uint32_t b)
+             {
+               return (data->labels[a].get_address ()
+                       < data->labels[b].get_address ());
+             });
+
+  data->order_valid = true;
+}
+
+size_t
+LabelTable::size (void) const
+{
+  return this->data->labels.size ();
+}
+
+bool
+LabelTable::empty (void) const
+{
+  return this->data->labels.empty ();
+}
+
+void
+LabelTable::clear (void)
+{
+  this->data = CowPtr<Data> ();
+}
+
+const Label *
+LabelTable::find (uint32_t address) const
+{
+  const Data *data;
+  size_t n;
+
+  data = this->data.get ();
+  if (data->labels.empty ())
+    return NULL;
+
+  n = find_slot (data, address);
+  if (data->slots[n] == empty_slot)
+    return NULL;
+
+  return &data->labels[data->slots[n]];
+}
+
+/** Returns the first label at address higher than given one. */
+const Label *
+LabelTable::find_next (uint32_t address) const
+{
+  std::vector<uint32_t>::const_iterator itr;
+  const Data *data;
+
+  this->update_order ();
+  data = this->data.get ();
+
+  itr = std::upper_bound (data->order.begin (), data->order.end (), address,
+                          [data] (uint32_t addr, uint32_t index)
+                          {
+                            return (addr
+                                    < data->labels[index].get_address ());
+                          });
+  if (itr == data->order.end ())
+    return NULL;
+
+  return &data->labels[*itr];
+}
+
+/** Returns n-th label in order of addresses. */
+const Label &
+LabelTable::get_sorted (size_t n) const
+{
+  this->update_order ();
+  return this->data->labels[this->data->order[n]];
+}
+
+/** Adds a label, replacing one at the same address. */
+void
+LabelTable::set (const Label &label)
+{
+  Data *data;
+  size_t n;
+
+  data = this->data.edit ();
+
+  if (2 * (data->labels.size () + 1) > data->slots.size ())
+    grow (data);
+
+  n = find_slot (data, label.get_address ());
+  if (data->slots[n] != empty_slot)
+    {
+      data->labels[data->slots[n]] = label;
+      return;
+    }
+
+  data->slots[n] = data->labels.size ();
+  data->labels.push_back (label);
+  data->order_valid = false;
+}
+
+void
+LabelTable::erase (uint32_t address)
+{
+  Data *data;
+  size_t mask;
+  size_t hole;
+  size_t n;
+  size_t home;
+  uint32_t index;
+  uint32_t last;
+
+  if (this->find (address) == NULL)
+    return;
+
+  data = this->data.edit ();
+  hole = find_slot (data, address);
+  index = data->slots[hole];
+  mask  = data->slots.size () - 1;
+
+  /* Shift following entries of the probe sequence back into the hole */
+  n = hole;
+  for (;;)
+    {
+      n = (n + 1) & mask;
+      if (data->slots[n] == empty_slot)
+        break;
+
+      home = hash_address (data->labels[data->slots[n]].get_address ()) & mask;
+      if (((n - home) & mask) >= ((n - hole) & mask))
+        {
+          data->slots[hole] = data->slots[n];
+          hole = n;
+        }
+    }
+
+  data->slots[hole] = empty_slot;
+
+  /* Move the last label into the freed place of the dense vector */
+  last = data->labels.size () - 1;
+  if (index != last)
+    {
+      data->labels[index] = data->labels[last];
+      data->slots[find_slot (data, data->labels[index].get_address ())]
+        = index;
+    }
+
+  data->labels.pop_back ();
+  data->order_valid = false;
+}
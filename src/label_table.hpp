@@ -0,0 +1,71 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file label_table.hpp
+ *     Header file for label_table.cpp, with declaration of LabelTable class.
+ * @par Purpose:
+ *     Storage for LabelTable class which holds all labels of the analysed
+ *     binary, indexed by address.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#ifndef LEDISASM_LABEL_TABLE_H
+#define LEDISASM_LABEL_TABLE_H
+
+#include <inttypes.h>
+#include <cstddef>
+#include <vector>
+
+#include "cow_ptr.hpp"
+#include "label.hpp"
+
+/** Table of labels.
+ *
+ * Labels are stored densely in a vector, with an open addressing hash
+ * of their indices for lookups by address. Address order, needed for
+ * finding the next label and for iteration, is built only when it is
+ * asked for after the set of addresses changed.
+ *
+ * Copies of the table share its contents until one of them is modified.
+ * Pointers to labels are valid only until the table is modified.
+ */
+class LabelTable
+{
+protected:
+  struct Data
+  {
+    std::vector<Label>    labels;
+    std::vector<uint32_t> slots;
+    std::vector<uint32_t> order;
+    bool                  order_valid;
+
+    Data (void);
+  };
+
+  mutable CowPtr<Data> data;
+
+protected:
+  static size_t find_slot (const Data *data, uint32_t address);
+  static void   grow (Data *data);
+  void   update_order (void) const;
+
+public:
+
+  size_t size (void) const;
+  bool   empty (void) const;
+  void   clear (void);
+
+  const Label *find (uint32_t address) const;
+  const Label *find_next (uint32_t address) const;
+  const Label &get_sorted (size_t n) const;
+
+  void set (const Label &label);
+  void erase (uint32_t address);
+};
+
+#endif // LEDISASM_LABEL_TABLE_H
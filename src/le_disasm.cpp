@@ -15,48 +15,126 @@
  *     the Free Software Foundation; either version 2 of the License, or
  *     (at your option) any later version.
  */
+#include <algorithm>
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <memory>
-#include <sstream>
+#include <vector>
+#include <unistd.h>
 
 #include "analyser.hpp"
+#include "database.hpp"
+#include "decoder.hpp"
+#include "disassembler.hpp"
 #include "error.hpp"
+#include "exporter.hpp"
+#include "function_diff.hpp"
 #include "image.hpp"
 #include "instruction.hpp"
 #include "known_file.hpp"
 #include "label.hpp"
 #include "le.hpp"
 #include "le_image.hpp"
+#include "output_sink.hpp"
+#include "parallel.hpp"
 #include "regions.hpp"
+#include "render_cache.hpp"
+#include "shadow_map.hpp"
+#include "signatures.hpp"
+#include "split_output.hpp"
+#include "symbol_index.hpp"
 #include "util.hpp"
 
-using std::ios;
+struct ProgramOptions
+{
+  const char        *fname;
+  AsmSyntax          syntax;
+  TraceQueue::Order  trace_order;
+  unsigned int       jobs;
+  bool               xrefs;
+  const char        *db_fname;
+  const char        *sig_fname;
+  const char        *make_sig_fname;
+  const char        *out_fname;
+  bool               split;
+  unsigned int       split_functions;
+  const char        *export_fname;
+  Exporter::Format   export_format;
+  const char        *diff_fname;
+};
 
 static void
-print_separator (void)
+print_separator (OutputSink *out)
 {
-  int n;
+  out->write ("/*", 2);
+  out->fill ('-', 64);
+  out->write ("*/\n", 3);
+}
+
+static void
+write_label (OutputSink *out, const Label *lab)
+{
+  if (lab->has_name ())
+    out->write (lab->get_name ());
+  else
+    {
+      out->write (lab->get_prefix ());
+      out->put ('_');
+      out->write_hex (lab->get_address (), false);
+    }
+}
+
+/* Most references listed at a label, the rest is only counted */
+static const size_t max_printed_xrefs = 16;
+
+static void
+print_xrefs (OutputSink *out, const Label *lab, const XrefTable *xrefs)
+{
+  static const char *const kind_names[] = { "call", "jump", "pointer" };
+  const XrefTable::Xref *refs;
+  size_t count;
+  size_t n;
+
+  refs = xrefs->find_to (lab->get_address (), &count);
+  if (count == 0)
+    return;
+
+  out->write ("\t\t/* xrefs:");
+
+  for (n = 0; n < count and n < max_printed_xrefs; n++)
+    {
+      if (n > 0)
+        out->put (',');
 
-  std::cout << "/*";
+      out->put (' ');
+      out->write (kind_names[refs[n].kind]);
+      out->put (' ');
+      out->write_hex (refs[n].source);
+    }
 
-  for (n = 0; n < 64; n++)
-    std::cout << '-';
+  if (count > max_printed_xrefs)
+    {
+      out->write (", and ");
+      out->write_dec (count - max_printed_xrefs);
+      out->write (" more");
+    }
 
-  std::cout << "*/\n";
+  out->write (" */\n");
 }
 
 static void
-print_label (const Label *lab)
+print_label (OutputSink *out, const Label *lab, const XrefTable *xrefs)
 {
   int indent;
 
   switch (lab->get_type ())
     {
     case Label::FUNCTION:
-      std::cout << "\n\n";
-      print_separator ();
+      out->write ("\n\n", 2);
+      print_separator (out);
       indent = 0;
       break;
 
@@ -70,7 +148,7 @@ print_label (const Label *lab)
 
     case Label::VTABLE:
       indent = 0;
-      std::cout << '\n';
+      out->put ('\n');
       break;
 
     default:
@@ -78,26 +156,26 @@ print_label (const Label *lab)
       break;
     }
 
-  while (indent-- > 0)
-    std::cout << '\t';
-
-  std::cout << *lab << ":";
+  out->fill ('\t', indent);
+  write_label (out, lab);
+  out->put (':');
 
-  if (!lab->get_name ().empty ())
+  if (lab->has_name ())
     {
-      PUSH_IOS_FLAGS (&std::cout);
-      std::cout.setf (ios::hex, ios::basefield);
-      std::cout.setf (ios::showbase);
-
-      std::cout << "\t/* " << lab->get_address () << " */";
+      out->write ("\t/* ", 4);
+      out->write_hex (lab->get_address ());
+      out->write (" */", 3);
     }
 
-  std::cout << '\n';
+  out->put ('\n');
+
+  if (xrefs != NULL)
+    print_xrefs (out, lab, xrefs);
 
   switch (lab->get_type ())
     {
     case Label::FUNCTION:
-      print_separator ();
+      print_separator (out);
       break;
 
     default:
@@ -105,201 +183,332 @@ print_label (const Label *lab)
     }
 }
 
-static std::string
-replace_addresses_with_labels (const std::string &str, Image *img,
-                               LinearExecutable *le, Analyser *anal)
+static const char missing_label_comment[] =
+  " /* Warning: address points to a valid object/reloc, but no label found */";
+
+static void
+replace_addresses_with_labels (const std::string &text,
+                               const SymbolIndex *symbols, std::string *str)
 {
-  std::ostringstream oss;
-  const Label *lab;
-  size_t n, start;
-  uint32_t addr;
-  std::string addr_str;
-  std::string comment;
+  str->clear ();
 
-  n = str.find ("0x");
-  if (n == std::string::npos)
-    return str;
+  if (symbols->symbolise (text, str))
+    str->append (missing_label_comment);
+}
 
-  start = 0;
+/** Renders natively decoded instruction through the template cache.
+ *
+ * Returns false if the instruction needs the disassembler library.
+ */
+static bool
+render_instruction (uint32_t addr, const Image::Object *obj, size_t length,
+                    LinearExecutable *le, const SymbolIndex *symbols,
+                    Disassembler *disasm, RenderCache *cache,
+                    std::string *str, size_t *size)
+{
+  DecodedInstruction decoded;
+  const RenderCache::Template *tpl;
+  RenderCache::Template *new_tpl;
+  const uint8_t *data;
+  const LEFM *fups;
+  uint32_t offset;
+  Operand *op;
+  std::string key;
+  std::string text;
+  bool warning;
+  size_t n;
+
+  data = obj->get_data_at (addr);
+  if (!decode_instruction (addr, data, length, &decoded))
+    return false;
+
+  fups = le->get_fixups_for_object (obj->get_index ());
+  offset = addr - obj->get_base_address ();
 
-  do
+  for (n = 0; n < decoded.operand_count; n++)
     {
-      oss << str.substr (start, n - start);
+      op = &decoded.operands[n];
 
-      if (n + 2 >= str.length ())
-        break;
+      if (op->type == Operand::TARGET
+          or (op->field_size == 4
+              and fups->find (offset + op->field_offset) != fups->end ()))
+        op->hole = 1 + n;
+    }
 
-      n += 2;
-      start = n;
+  RenderCache::make_key (&decoded, data, &key);
 
-      while (n < str.length () and isxdigit (str[n]))
-        n++;
+  tpl = cache->find (key);
+  if (tpl == NULL)
+    {
+      disasm->format (&decoded, &text);
 
-      addr_str = str.substr (start, n - start);
-      addr = strtol (addr_str.c_str (), NULL, 16);
-      lab = anal->get_label (addr);
-      if (lab != NULL)
-        oss << *lab;
-      else
-        {
-          oss << "0x" << addr_str;
+      new_tpl = cache->insert (key);
+      new_tpl->text.clear ();
+      new_tpl->warning = symbols->symbolise (text, &new_tpl->text);
+      tpl = new_tpl;
+    }
 
-          if (img->get_object_at_address (addr) != NULL
-              and le->get_fixup_addresses ()->find (addr)
-                  != le->get_fixup_addresses ()->end ())
-            {
-              comment = " /* Warning: address points to a valid object/reloc, "
-                        "but no label found */";
-            }
+  str->clear ();
+  warning = tpl->warning;
+
+  for (n = 0; n < tpl->text.size (); n++)
+    {
+      if (!RenderCache::is_hole_marker (tpl->text[n]))
+        {
+          str->push_back (tpl->text[n]);
+          continue;
         }
 
-      start = n;
-      n = str.find ("0x", start);
+      op = &decoded.operands[(tpl->text[n] & ~OPERAND_HOLE_PLUS) - 1];
+      if ((tpl->text[n] & OPERAND_HOLE_PLUS) != 0
+          and (int32_t) op->value >= 0)
+        str->push_back ('+');
+
+      op->hole = 0;
+      text.clear ();
+      append_operand_value (&text, op);
+      if (symbols->symbolise (text, str,
+                              (op->type == Operand::IMMEDIATE
+                               ? SymbolIndex::IMMEDIATE
+                               : SymbolIndex::ADDRESS)))
+        warning = true;
     }
-  while (n != std::string::npos);
 
-  if (start < str.length ())
-    oss << str.substr (start);
+  if (warning)
+    str->append (missing_label_comment);
 
-  if (!comment.empty ())
-    oss << comment;
-
-  return oss.str ();
+  *size = decoded.size;
+  return true;
 }
 
 static void
-print_instruction (Instruction *inst, Image *img, LinearExecutable *le,
-                   Analyser *anal)
+print_instruction (OutputSink *out, const std::string &str)
 {
-  std::string str;
   std::string::size_type n;
 
-  str = replace_addresses_with_labels (inst->get_string (), img, le, anal);
-
   n = str.find ("(287 only)");
   if (n != std::string::npos)
     {
-      std::cout << "\t\t/* " << str << " -- ignored */\n";
+      out->write ("\t\t/* ");
+      out->write (str);
+      out->write (" -- ignored */\n");
       return;
     }
 
+  out->write ("\t\t", 2);
+
   /* Work around buggy libopcodes */
   if (str == "lar    %cx,%ecx")
-    str = "lar    %ecx,%ecx";
+    out->write ("lar    %ecx,%ecx");
   else if (str == "lsl    %ax,%eax")
-    str = "lsl    %eax,%eax";
-
-  std::cout << "\t\t" << str;
+    out->write ("lsl    %eax,%eax");
+  else
+    out->write (str);
 
   if (str == "data16" or str == "data32")
-    std::cout << " ";
+    out->put (' ');
   else
-    std::cout << "\n";
+    out->put ('\n');
 }
 
-static bool
-data_is_address (const Image::Object *obj, uint32_t addr, size_t len,
-                 LinearExecutable *le)
+/** Text of bytes within quoted strings, looked up instead of computed.
+ */
+struct EscapeTable
 {
-  uint32_t offset;
-  const LEFM *fups;
+  char special[256];    /* escape letter, or 0 if written as it is */
+  char hex[256][4];     /* "\xNN" escape of every byte */
 
-  if (len < 4)
-    return false;
+  EscapeTable (void)
+  {
+    static const char digits[] = "0123456789abcdef";
+    size_t n;
+
+    memset (this->special, 0, sizeof (this->special));
+    this->special[(uint8_t) '\t'] = 't';
+    this->special[(uint8_t) '\r'] = 'r';
+    this->special[(uint8_t) '\n'] = 'n';
+    this->special[(uint8_t) '\\'] = '\\';
+    this->special[(uint8_t) '"'] = '"';
+
+    for (n = 0; n < 256; n++)
+      {
+        this->hex[n][0] = '\\';
+        this->hex[n][1] = 'x';
+        this->hex[n][2] = digits[n >> 4];
+        this->hex[n][3] = digits[n & 0xf];
+      }
+  }
+};
+
+static const EscapeTable escapes;
 
-  fups = le->get_fixups_for_object (obj->get_index ());
-  offset = addr - obj->get_base_address ();
+static void
+print_escaped_string (OutputSink *out, const uint8_t *data, size_t len)
+{
+  size_t start;
+  size_t n;
 
-  if (fups->find (offset) == fups->end ())
-    return false;
+  start = 0;
 
-  return true;
+  for (n = 0; n < len; n++)
+    {
+      if (escapes.special[data[n]] == 0)
+        continue;
+
+      out->write ((const char *) data + start, n - start);
+      out->put ('\\');
+      out->put (escapes.special[data[n]]);
+      start = n + 1;
+    }
+
+  out->write ((const char *) data + start, len - start);
 }
 
-static bool
-data_is_zeros (const Image::Object *obj, uint32_t addr, size_t len, size_t *rlen)
+static void
+print_real (OutputSink *out, double value, bool single)
 {
-  size_t x;
-  const uint8_t *data;
-
-  data = obj->get_data_at (addr);
+  char buffer[32];
+  int digits;
 
-  for (x = 0; x < len; x++)
+  /* Shortest text which reads back as the same value */
+  for (digits = (single ? 6 : 15); digits < (single ? 9 : 17); digits++)
     {
-      if (data[x] != 0)
+      snprintf (buffer, sizeof (buffer), "%.*g", digits, value);
+
+      if (single ? strtof (buffer, NULL) == (float) value
+                 : strtod (buffer, NULL) == value)
         break;
     }
 
-  if (x < 4)
-    return false;
-
-  *rlen = x;
-  return true;
+  snprintf (buffer, sizeof (buffer), "%.*g", digits, value);
+  out->write (buffer);
 }
 
-static bool
-data_is_string (const Image::Object *obj, uint32_t addr, size_t len, size_t *rlen,
-                bool *zero_terminated)
+static void
+print_data (OutputSink *out, const Region *reg, const Image::Object *obj,
+            Analyser *anal)
 {
-  size_t x;
   const uint8_t *data;
+  const Label *label;
+  uint32_t value;
+  size_t n;
+  float f;
+  double d;
 
-  data = obj->get_data_at (addr);
+  data = obj->get_data_at (reg->get_address ());
 
-  for (x = 0; x < len; x++)
+  switch (reg->get_type ())
     {
-      if ((data[x] < 0x20 or data[x] >= 0x7f)
-          and not (data[x] == '\t' or data[x] == '\n' or data[x] == '\r'))
-        break;
-    }
+    case Region::POINTER:
+    case Region::POINTER_ARRAY:
+      for (n = 0; n < reg->get_size (); n += 4)
+        {
+          value = read_le<uint32_t> (data + n);
+          label = anal->get_label (value);
 
-  if (x < 4)
-    return false;
+          out->write ("\t\t.long   ");
 
-  if (x < len and data[x] == 0)
-    {
-      *zero_terminated = true;
-      x += 1;
-    }
-  else
-    *zero_terminated = false;
+          if (label != NULL)
+            write_label (out, label);
+          else
+            {
+              /* Data made of a rejected guess may point anywhere */
+              out->write_hex (value);
+              out->write (missing_label_comment);
+            }
 
-  *rlen = x;
-  return true;
-}
+          out->put ('\n');
+        }
+      break;
 
-static void
-print_escaped_string (const uint8_t *data, size_t len)
-{
-  size_t n;
+    case Region::ZERO_FILL:
+      out->write ("\t\t.fill   ");
+      out->write_hex (reg->get_size ());
+      out->put ('\n');
+      break;
 
-  for (n = 0; n < len; n++)
-    {
-      if (data[n] == '\t')
-        std::cout << "\\t";
-      else if (data[n] == '\r')
-        std::cout << "\\r";
-      else if (data[n] == '\n')
-        std::cout << "\\n";
-      else if (data[n] == '\\')
-        std::cout << "\\\\";
-      else if (data[n] == '"')
-        std::cout << "\\\"";
-      else
-        std::cout << (char) data[n];
+    case Region::C_STRING:
+      out->write ("\t\t.string \"");
+      print_escaped_string (out, data, reg->get_size () - 1);
+      out->write ("\"\n", 2);
+      break;
+
+    case Region::ASCII:
+      out->write ("\t\t.ascii   \"");
+      print_escaped_string (out, data, reg->get_size ());
+      out->write ("\"\n", 2);
+      break;
+
+    case Region::FLOAT_TABLE:
+      for (n = 0; n < reg->get_size (); n += 4)
+        {
+          value = read_le<uint32_t> (data + n);
+          memcpy (&f, &value, sizeof (f));
+
+          out->write ("\t\t.float  ");
+          print_real (out, f, true);
+          out->put ('\n');
+        }
+      break;
+
+    case Region::DOUBLE_TABLE:
+      for (n = 0; n < reg->get_size (); n += 8)
+        {
+          uint64_t bits;
+
+          bits = read_le<uint64_t> (data + n);
+          memcpy (&d, &bits, sizeof (d));
+
+          out->write ("\t\t.double ");
+          print_real (out, d, false);
+          out->put ('\n');
+        }
+      break;
+
+    case Region::INT16_TABLE:
+      for (n = 0; n < reg->get_size (); n += 2)
+        {
+          out->write ("\t\t.short  ");
+          out->write_dec ((int16_t) read_le<uint16_t> (data + n));
+          out->put ('\n');
+        }
+      break;
+
+    case Region::INT32_TABLE:
+      for (n = 0; n < reg->get_size (); n += 4)
+        {
+          out->write ("\t\t.long   ");
+          out->write_dec ((int32_t) read_le<uint32_t> (data + n));
+          out->put ('\n');
+        }
+      break;
+
+    default:
+      for (n = 0; n < reg->get_size (); n++)
+        {
+          if (n % 8 == 0)
+            out->write ("\t\t.ascii  \"");
+
+          out->write (escapes.hex[data[n]], 4);
+
+          if (n % 8 == 7 or n + 1 == reg->get_size ())
+            out->write ("\"\n", 2);
+        }
+      break;
     }
 }
 
 static void
-print_region (const Region *reg, const Image::Object *obj, LinearExecutable *le,
-              Image *img, Analyser *anal)
+print_region (OutputSink *out, const Region *reg, const Image::Object *obj,
+              LinearExecutable *le, Image *img, Analyser *anal,
+              const SymbolIndex *symbols, Disassembler *disasm,
+              RenderCache *cache, const XrefTable *xrefs)
 {
   const Label *label;
   size_t addr;
-  int bytes_in_line;
-  Disassembler disasm;
   Instruction inst;
-  LEFM::const_iterator itr;
+  std::string str;
+  size_t inst_size;
 
 #ifdef DEBUG
   std::cerr << "Region: " << *reg << std::endl;
@@ -315,142 +524,40 @@ print_region (const Region *reg, const Image::Object *obj, LinearExecutable *le,
         {
           label = anal->get_label (addr);
           if (label != NULL)
-            print_label (label);
+            print_label (out, label, xrefs);
+
+          if (!render_instruction (addr, obj, reg->get_end_address () - addr,
+                                   le, symbols, disasm, cache,
+                                   &str, &inst_size))
+            {
+              disasm->disassemble (addr, obj->get_data_at (addr),
+                                   reg->get_end_address () - addr, &inst);
+              replace_addresses_with_labels (inst.get_string (), symbols,
+                                             &str);
+              inst_size = inst.get_size ();
+            }
 
-          disasm.disassemble (addr, obj->get_data_at (addr),
-                              reg->get_end_address () - addr, &inst);
-          print_instruction (&inst, img, le, anal);
+          print_instruction (out, str);
 
-          addr += inst.get_size ();
+          addr += inst_size;
         }
       break;
 
     case Region::DATA:
-      size_t len;
-      size_t size;
-      const Label *label;
-      const LEFM *fups;
-      bool zt;
+      const Region *typed;
+      size_t count;
+      size_t n;
 
-      bytes_in_line = 0;
+      typed = anal->get_data_types ()->find_within (reg, &count);
 
-      fups = le->get_fixups_for_object (obj->get_index ());
-      itr = fups->begin ();
-
-      while (addr < reg->get_end_address ())
+      for (n = 0; n < count; n++)
         {
-          label = anal->get_label (addr);
-          if (label != NULL)
-            {
-              if (bytes_in_line > 0)
-                {
-                  std::cout << "\"\n";
-                  bytes_in_line = 0;
-                }
-
-              print_label (label);
-            }
-
-          len = reg->get_end_address () - addr;
-
-          label = anal->get_next_label (addr);
+          label = anal->get_label (typed[n].get_address ());
           if (label != NULL)
-            len = std::min (len, label->get_address () - addr);
-
-          while (itr != fups->end ()
-                 and itr->first <= addr - obj->get_base_address ())
-            ++itr;
-
-          if (itr != fups->end ())
-            len = std::min<size_t> (len,
-                                    itr->first
-                                    - (addr - obj->get_base_address ()));
-
-          while (len > 0)
-            {
-              if (data_is_address (obj, addr, len, le))
-                {
-                  const Label *dlabel;
-                  uint32_t value;
-
-                  if (bytes_in_line > 0)
-                    {
-                      std::cout << "\"\n";
-                      bytes_in_line = 0;
-                    }
-
-                  value = read_le<uint32_t> (obj->get_data_at (addr));
-                  dlabel = anal->get_label (value);
-                  assert (dlabel != NULL);
-                  std::cout << "\t\t.long   " << *dlabel << "\n";
-
-                  addr += 4;
-                  len -= 4;
-                }
-              else if (data_is_zeros (obj, addr, len, &size))
-                {
-                  PUSH_IOS_FLAGS (&std::cout);
-                  std::cout.setf (ios::hex, ios::basefield);
-                  std::cout.setf (ios::showbase);
-
-                  if (bytes_in_line > 0)
-                    {
-                      std::cout << "\"\n";
-                      bytes_in_line = 0;
-                    }
-
-                  std::cout << "\t\t.fill   " << size << "\n";
-                  addr += size;
-                  len -= size;
-                }
-              else if (data_is_string (obj, addr, len, &size, &zt))
-                {
-                  if (bytes_in_line > 0)
-                    {
-                      std::cout << "\"\n";
-                      bytes_in_line = 0;
-                    }
-
-                  if (zt)
-                    std::cout << "\t\t.string \"";
-                  else
-                    std::cout << "\t\t.ascii   \"";
+            print_label (out, label, xrefs);
 
-                  print_escaped_string (obj->get_data_at (addr), size - zt);
-
-                  std::cout << "\"\n";
-
-                  addr += size;
-                  len -= size;
-                }
-              else
-                {
-                  char buffer[8];
-
-                  if (bytes_in_line == 0)
-                    std::cout << "\t\t.ascii  \"";
-
-                  snprintf (buffer, sizeof (buffer), "\\x%02x",
-                            *obj->get_data_at (addr));
-                  std::cout << buffer;
-
-                  bytes_in_line += 1;
-                  
-                  if (bytes_in_line == 8)
-                    {
-                      std::cout << "\"\n";
-                      bytes_in_line = 0;
-                    }
-
-                  addr++;
-                  len--;
-                }
-            }
+          print_data (out, &typed[n], obj, anal);
         }
-
-      if (bytes_in_line > 0)
-        std::cout << "\"\n";
-
       break;
 
     case Region::VTABLE:
@@ -459,14 +566,14 @@ print_region (const Region *reg, const Image::Object *obj, LinearExecutable *le,
 
       /* TODO: limit by relocs */
 
-      print_label (anal->get_label (addr));
+      print_label (out, anal->get_label (addr), xrefs);
       next_label = anal->get_next_label (addr);
 
       while (addr < reg->get_end_address ())
         {
           if (next_label != NULL and addr == next_label->get_address ())
             {
-              print_label (next_label);
+              print_label (out, next_label, xrefs);
               next_label = anal->get_next_label (addr);
             }
 
@@ -476,10 +583,12 @@ print_region (const Region *reg, const Image::Object *obj, LinearExecutable *le,
             {
               label = anal->get_label (func_addr);
               assert (label != NULL);
-              std::cout << "\t\t.long   " << *label << "\n";
+              out->write ("\t\t.long   ");
+              write_label (out, label);
+              out->put ('\n');
             }
           else
-            std::cout << "\t\t.long   0\n";
+            out->write ("\t\t.long   0\n");
 
           addr += 4;
         }
@@ -490,69 +599,378 @@ print_region (const Region *reg, const Image::Object *obj, LinearExecutable *le,
     }
 }
 
-static void
-print_code (LinearExecutable *le, Image *img, Analyser *anal)
+static const char intel_syntax_header[] =
+  ".intel_syntax noprefix\n.intel_mnemonic\n";
+
+enum Section
 {
-  enum Section
-  {
-    NONE,
-    TEXT,
-    DATA
-  };
+  SECTION_NONE,
+  SECTION_TEXT,
+  SECTION_DATA
+};
 
-  Analyser::RegionMap::const_iterator itr;
+static Section
+get_section (const Region *reg)
+{
+  if (reg->get_type () == Region::DATA)
+    return SECTION_DATA;
+
+  return SECTION_TEXT;
+}
+
+/** Regions printed together, the first and last of them possibly only
+ * in part.
+ */
+struct RegionRange
+{
+  size_t   begin;       /* index of the first region */
+  size_t   end;         /* index past the last region */
+  uint32_t start;       /* address where printing starts */
+  uint32_t stop;        /* address where printing stops */
+  bool     new_file;    /* whether the range is printed to a file of its own */
+};
+
+/** Prints given range of regions.
+ *
+ * Section directives are printed where the section differs from the one
+ * of the region before, so a range which does not start a new file
+ * prints the same text as it does as a part of the whole listing.
+ * Only code regions may be cut by the range.
+ */
+static void
+print_regions (OutputSink *out, const RegionRange *range,
+               LinearExecutable *le, Image *img, Analyser *anal,
+               const SymbolIndex *symbols, Disassembler *disasm,
+               RenderCache *cache, const XrefTable *xrefs)
+{
   const Analyser::RegionMap *regions;
   const Region *prev = NULL;
   const Region *next;
   const Region *reg;
   const Image::Object *obj;
-  Section sec = NONE;
+  Section sec = SECTION_NONE;
+  uint32_t start;
+  uint32_t end;
+  size_t n;
 
   regions = anal->get_regions ();
 
-  std::cerr << "Region count: " << regions->size () << "\n";
+  if (range->begin > 0)
+    {
+      prev = &regions->at (range->begin - 1);
+      if (!range->new_file)
+        sec = get_section (prev);
+    }
 
-  for (itr = regions->begin (); itr != regions->end (); ++itr)
+  for (n = range->begin; n < range->end; n++)
     {
-      reg = &itr->second;
+      reg = &regions->at (n);
       obj = img->get_object_at_address (reg->get_address ());
 
-      if (reg->get_type () == Region::DATA)
+      if (sec != get_section (reg))
         {
-          if (sec != DATA)
-            {
-              std::cout << ".data\n";
-              sec = DATA;
-            }
+          sec = get_section (reg);
+          out->write (sec == SECTION_DATA ? ".data\n" : ".text\n");
         }
-      else
+
+      if (reg->get_address () < range->start
+          or reg->get_end_address () > range->stop)
         {
-          if (sec != TEXT)
-            {
-              std::cout << ".text\n";
-              sec = TEXT;
-            }
-        }
+          assert (reg->get_type () == Region::CODE);
 
-      print_region (reg, obj, le, img, anal);
+          start = std::max<uint32_t> (reg->get_address (), range->start);
+          end   = std::min<uint32_t> (reg->get_end_address (), range->stop);
+
+          Region piece (start, end - start, Region::CODE);
+
+          print_region (out, &piece, obj, le, img, anal, symbols, disasm,
+                        cache, xrefs);
+        }
+      else
+        print_region (out, reg, obj, le, img, anal, symbols, disasm, cache,
+                      xrefs);
 
       if (prev != NULL)
         assert (prev->get_end_address () <= reg->get_address ());
 
       next = anal->get_next_region (reg);
-      if (next == NULL or next->get_address () > reg->get_end_address ())
+      if (reg->get_end_address () <= range->stop
+          and (next == NULL
+               or next->get_address () > reg->get_end_address ()))
         {
           const Label *l;
 
           l = anal->get_label (reg->get_end_address ());
           if (l != NULL)
-            print_label (l);
+            print_label (out, l, xrefs);
         }
 
       prev = reg;
     }
 }
 
+/** Renders every range into its text, on as many threads as there are
+ * disassemblers.
+ */
+static void
+render_ranges (const RegionRange *ranges, size_t count, std::string *texts,
+               LinearExecutable *le, Image *img, Analyser *anal,
+               const SymbolIndex *symbols,
+               std::vector<Disassembler> *disasms,
+               std::vector<RenderCache> *caches, const XrefTable *xrefs)
+{
+  parallel_for (count, disasms->size (),
+                [&] (size_t index, unsigned int worker)
+                {
+                  OutputSink sink (&texts[index]);
+
+                  print_regions (&sink, &ranges[index], le, img, anal,
+                                 symbols, &(*disasms)[worker],
+                                 &(*caches)[worker], xrefs);
+                  sink.flush ();
+                });
+}
+
+/** Ends the last range before given region and address, if there is one,
+ * and starts a new one there.
+ */
+static void
+start_range (const Analyser::RegionMap *regions, size_t index,
+             uint32_t addr, bool new_file, std::vector<RegionRange> *ranges)
+{
+  RegionRange range;
+
+  if (not ranges->empty ())
+    {
+      if (ranges->back ().start == addr)
+        return;
+
+      ranges->back ().end  = index;
+      ranges->back ().stop = addr;
+
+      /* The region at index is cut, its start belongs to the last range */
+      if (index < regions->size ()
+          and regions->at (index).get_address () < addr)
+        ranges->back ().end = index + 1;
+    }
+
+  range.begin    = index;
+  range.end      = regions->size ();
+  range.start    = addr;
+  range.stop     = regions->at (regions->size () - 1).get_end_address ();
+  range.new_file = new_file;
+  ranges->push_back (range);
+}
+
+/** Splits regions into chunks spanning at least given number of bytes.
+ */
+static void
+split_regions (const Analyser::RegionMap *regions, uint32_t span,
+               std::vector<RegionRange> *ranges)
+{
+  size_t n;
+
+  ranges->clear ();
+
+  for (n = 0; n < regions->size (); n++)
+    {
+      if (ranges->empty ()
+          or regions->at (n).get_address () - ranges->back ().start >= span)
+        start_range (regions, n, regions->at (n).get_address (), false,
+                     ranges);
+    }
+}
+
+/** Splits regions into parts at starts of objects, and within code every
+ * given number of functions unless it is zero.
+ *
+ * Code is cut only at labels of functions where tracing found
+ * an instruction, so every part starts with its first function.
+ */
+static void
+split_parts (Analyser *anal, Image *img, size_t functions,
+             std::vector<RegionRange> *parts)
+{
+  const Analyser::RegionMap *regions;
+  const Image::Object *prev_obj = NULL;
+  const Image::Object *obj;
+  const Region *reg;
+  const Label *lab;
+  size_t count = 0;
+  size_t n;
+
+  regions = anal->get_regions ();
+  parts->clear ();
+
+  for (n = 0; n < regions->size (); n++)
+    {
+      reg = &regions->at (n);
+      obj = img->get_object_at_address (reg->get_address ());
+
+      if (n == 0 or (obj != NULL and obj != prev_obj))
+        {
+          start_range (regions, n, reg->get_address (), true, parts);
+          prev_obj = obj;
+          count = 0;
+        }
+
+      if (functions == 0 or reg->get_type () != Region::CODE)
+        continue;
+
+      lab = anal->get_label (reg->get_address ());
+      if (lab == NULL)
+        lab = anal->get_next_label (reg->get_address ());
+
+      for (; lab != NULL and lab->get_address () < reg->get_end_address ();
+           lab = anal->get_next_label (lab))
+        {
+          if (lab->get_type () != Label::FUNCTION
+              or (anal->get_shadow ()->get_flags (lab->get_address ())
+                  & ShadowMap::CODE_START) == 0)
+            continue;
+
+          if (count == functions)
+            {
+              start_range (regions, n, lab->get_address (), true, parts);
+              count = 0;
+            }
+
+          count++;
+        }
+    }
+}
+
+/** Prints all regions.
+ *
+ * With more than one job, regions are rendered in chunks on many threads,
+ * each chunk into its own buffer. The buffers are written out in address
+ * order, a batch of chunks at a time, which keeps the output the same
+ * as the one printed sequentially.
+ */
+static void
+print_code (OutputSink *out, LinearExecutable *le, Image *img, Analyser *anal,
+            AsmSyntax syntax, bool with_xrefs, unsigned int jobs)
+{
+  /* Address span of a chunk, some 200 KiB of text when it is all code */
+  static const uint32_t chunk_span = 0x4000;
+
+  const Analyser::RegionMap *regions;
+  const XrefTable *xrefs = NULL;
+  SymbolIndex symbols;
+  std::vector<RegionRange> chunks;
+  std::vector<std::string> texts;
+  size_t batch_size;
+  size_t batch;
+  size_t n;
+
+  regions = anal->get_regions ();
+
+  if (with_xrefs)
+    xrefs = anal->get_xrefs ();
+
+  std::cerr << "Region count: " << regions->size () << "\n";
+
+  symbols.build (anal, le, img, syntax);
+
+  if (syntax == SYNTAX_INTEL)
+    out->write (intel_syntax_header);
+
+  split_regions (regions, chunk_span, &chunks);
+
+  if (jobs > chunks.size ())
+    jobs = std::max<size_t> (chunks.size (), 1);
+
+  std::vector<Disassembler> disasms (jobs, Disassembler (syntax));
+  std::vector<RenderCache> caches (jobs);
+
+  if (jobs <= 1)
+    {
+      for (n = 0; n < chunks.size (); n++)
+        print_regions (out, &chunks[n], le, img, anal, &symbols,
+                       &disasms[0], &caches[0], xrefs);
+    }
+  else
+    {
+      anal->build_lookups ();
+
+      batch_size = 4 * jobs;
+
+      for (batch = 0; batch < chunks.size (); batch += batch_size)
+        {
+          texts.assign (std::min (batch_size, chunks.size () - batch),
+                        std::string ());
+
+          render_ranges (&chunks[batch], texts.size (), texts.data (),
+                         le, img, anal, &symbols, &disasms, &caches, xrefs);
+
+          for (n = 0; n < texts.size (); n++)
+            out->write (texts[n]);
+        }
+    }
+
+#ifdef DEBUG
+  size_t hits = 0;
+  size_t misses = 0;
+
+  for (n = 0; n < caches.size (); n++)
+    {
+      hits   += caches[n].get_hits ();
+      misses += caches[n].get_misses ();
+    }
+
+  std::cerr << "Render cache: " << hits << " hits, "
+            << misses << " misses\n";
+  std::cerr << "Control flow graph: " << std::dec
+            << anal->get_cfg ()->get_block_count () << " blocks, "
+            << anal->get_cfg ()->get_function_count () << " functions\n";
+#endif
+}
+
+/** Prints all regions into a number of files, one for every object or for
+ * given number of functions, and a file including them.
+ */
+static void
+print_split_code (const char *fname, LinearExecutable *le, Image *img,
+                  Analyser *anal, AsmSyntax syntax, bool with_xrefs,
+                  unsigned int jobs, size_t functions)
+{
+  const XrefTable *xrefs = NULL;
+  SymbolIndex symbols;
+  SplitOutput split;
+  std::vector<RegionRange> parts;
+  std::vector<std::string> texts;
+  size_t n;
+
+  if (with_xrefs)
+    xrefs = anal->get_xrefs ();
+
+  std::cerr << "Region count: " << anal->get_regions ()->size () << "\n";
+
+  symbols.build (anal, le, img, syntax);
+  split_parts (anal, img, functions, &parts);
+
+  jobs = std::max<size_t> (std::min<size_t> (jobs, parts.size ()), 1);
+
+  std::vector<Disassembler> disasms (jobs, Disassembler (syntax));
+  std::vector<RenderCache> caches (jobs);
+
+  if (jobs > 1)
+    anal->build_lookups ();
+
+  texts.resize (parts.size ());
+  render_ranges (parts.data (), parts.size (), texts.data (), le, img, anal,
+                 &symbols, &disasms, &caches, xrefs);
+
+  split.resize (parts.size ());
+  for (n = 0; n < parts.size (); n++)
+    split.get_text (n)->swap (texts[n]);
+
+  split.link ();
+  split.write (fname, syntax == SYNTAX_INTEL ? intel_syntax_header : "");
+
+  std::cerr << "Output split into " << split.size () << " file(s).\n";
+}
+
 void
 debug_print_regions (Analyser *anal)
 {
@@ -564,55 +982,270 @@ debug_print_regions (Analyser *anal)
   std::cout << "---------- Regions -------------\n";
 
   for (itr = map->begin (); itr != map->end (); ++itr)
-    std::cout << itr->second << "\n";
+    std::cout << *itr << "\n";
 }
 
-void
-main_execute(const char *options_fname)
+/** Loads an executable and analyses it, or loads its analysis from
+ * the database if one is given.
+ */
+static void
+load_executable (const char *fname, const ProgramOptions *opts,
+                 const char *db_fname, std::unique_ptr<LinearExecutable> *le,
+                 std::unique_ptr<Image> *image, Analyser *anal)
 {
-  std::unique_ptr<LinearExecutable> le;
-  std::unique_ptr<Image> image;
   std::ifstream ifs;
-  Analyser anal;
+  uint64_t input_hash = 0;
+  uint64_t config_hash = 0;
+  bool loaded = false;
 
-  ifs.open (options_fname, std::ios::binary);
+  ifs.open (fname, std::ios::binary);
   if(!ifs.is_open())
     {
-      throw Error() << "Error opening file: " << options_fname;
+      throw Error() << "Error opening file: " << fname;
     }
 
-  le = std::unique_ptr<LinearExecutable>(
-      LinearExecutable::load (&ifs, options_fname)
+  *le = std::unique_ptr<LinearExecutable>(
+      LinearExecutable::load (&ifs, fname)
   );
 
-  image = std::unique_ptr<Image>(
-      create_image (&ifs, le.get())
+  *image = std::unique_ptr<Image>(
+      create_image (&ifs, le->get())
   );
 
-  anal = Analyser (le.get(), image.get());
+  *anal = Analyser (le->get(), image->get());
+  anal->set_trace_order (opts->trace_order);
+  anal->set_jobs (opts->jobs);
+
+  KnownFile::check(*anal, le->get());
+  KnownFile::pre_anal_fixups_apply(*anal);
+
+  if (opts->sig_fname != NULL)
+    {
+      SignatureLibrary sigs;
+
+      sigs.load (opts->sig_fname);
+      sigs.apply (anal, le->get (), image->get ());
+    }
+
+  if (db_fname != NULL)
+    {
+      input_hash  = AnalysisDatabase::hash_input (&ifs);
+      config_hash = anal->get_config_hash ();
+      loaded = AnalysisDatabase::load (db_fname, input_hash,
+                                       config_hash, anal);
+    }
+
+  if (!loaded)
+    {
+      anal->run ();
+
+      KnownFile::post_anal_fixups_apply(*anal);
 
-  KnownFile::check(anal, le.get());
-  KnownFile::pre_anal_fixups_apply(anal);
+      if (db_fname != NULL)
+        AnalysisDatabase::save (db_fname, input_hash, config_hash, anal);
+    }
+}
 
-  anal.run ();
+/** Compares functions of given executable with an older version of it,
+ * which is analysed the same way, except for the database.
+ */
+static void
+print_diff (const ProgramOptions *opts, LinearExecutable *le, Image *img,
+            Analyser *anal)
+{
+  std::unique_ptr<LinearExecutable> old_le;
+  std::unique_ptr<Image> old_image;
+  std::unique_ptr<OutputSink> out;
+  Analyser old_anal;
+  Disassembler disasm (opts->syntax);
+  FunctionDiff diff;
+
+  load_executable (opts->diff_fname, opts, NULL, &old_le, &old_image,
+                   &old_anal);
+
+  diff.add_functions (FunctionDiff::OLD, old_le.get (), old_image.get (),
+                      &old_anal, &disasm);
+  diff.add_functions (FunctionDiff::NEW, le, img, anal, &disasm);
+  diff.match ();
+
+  if (opts->out_fname != NULL)
+    out.reset (new OutputSink (opts->out_fname));
+  else
+    out.reset (new OutputSink (STDOUT_FILENO));
 
-  KnownFile::post_anal_fixups_apply(anal);
+  diff.print (out.get ());
+  out->flush ();
 
-  print_code (le.get(), image.get(), &anal);
+  std::cerr << "Functions: "
+            << diff.count (FunctionDiff::UNCHANGED) << " unchanged, "
+            << diff.count (FunctionDiff::MOVED) << " moved, "
+            << diff.count (FunctionDiff::CHANGED) << " changed, "
+            << diff.count (FunctionDiff::ADDED) << " added, "
+            << diff.count (FunctionDiff::REMOVED) << " removed.\n";
+}
+
+void
+main_execute(const ProgramOptions *opts)
+{
+  std::unique_ptr<LinearExecutable> le;
+  std::unique_ptr<Image> image;
+  std::unique_ptr<OutputSink> out;
+  Analyser anal;
+  Disassembler disasm (opts->syntax);
+
+  load_executable (opts->fname, opts, opts->db_fname, &le, &image, &anal);
+
+  if (opts->make_sig_fname != NULL)
+    SignatureLibrary::write (opts->make_sig_fname, &anal, le.get (),
+                             image.get (), &disasm);
+
+  if (opts->diff_fname != NULL)
+    {
+      print_diff (opts, le.get (), image.get (), &anal);
+      return;
+    }
+
+  if (opts->export_fname != NULL)
+    {
+      if (strcmp (opts->export_fname, "-") == 0)
+        out.reset (new OutputSink (STDOUT_FILENO));
+      else
+        out.reset (new OutputSink (opts->export_fname));
+
+      Exporter exporter (out.get (), opts->export_format);
+
+      exporter.write (le.get (), image.get (), &anal, &disasm);
+      out->flush ();
+      return;
+    }
+
+  if (opts->split)
+    {
+      print_split_code (opts->out_fname, le.get (), image.get (), &anal,
+                        opts->syntax, opts->xrefs, opts->jobs,
+                        opts->split_functions);
+      return;
+    }
+
+  if (opts->out_fname != NULL)
+    out.reset (new OutputSink (opts->out_fname));
+  else
+    out.reset (new OutputSink (STDOUT_FILENO));
+
+  print_code (out.get (), le.get(), image.get(), &anal, opts->syntax,
+              opts->xrefs, opts->jobs);
+  out->flush ();
+}
+
+static bool
+parse_options (int argc, char **argv, ProgramOptions *opts)
+{
+  int n;
+
+  opts->fname  = NULL;
+  opts->syntax = SYNTAX_ATT;
+  opts->trace_order = TraceQueue::FIFO;
+  opts->jobs = 1;
+  opts->xrefs = false;
+  opts->db_fname = NULL;
+  opts->sig_fname = NULL;
+  opts->make_sig_fname = NULL;
+  opts->out_fname = NULL;
+  opts->split = false;
+  opts->split_functions = 0;
+  opts->export_fname = NULL;
+  opts->export_format = Exporter::JSON_LINES;
+  opts->diff_fname = NULL;
+
+  for (n = 1; n < argc; n++)
+    {
+      if (strcmp (argv[n], "--syntax=att") == 0)
+        opts->syntax = SYNTAX_ATT;
+      else if (strcmp (argv[n], "--syntax=intel") == 0)
+        opts->syntax = SYNTAX_INTEL;
+      else if (strcmp (argv[n], "--trace-order=fifo") == 0)
+        opts->trace_order = TraceQueue::FIFO;
+      else if (strcmp (argv[n], "--trace-order=address") == 0)
+        opts->trace_order = TraceQueue::ADDRESS;
+      else if (strncmp (argv[n], "--jobs=", 7) == 0)
+        {
+          char *end;
+
+          opts->jobs = strtoul (argv[n] + 7, &end, 10);
+          if (end == argv[n] + 7 or *end != '\0')
+            return false;
+
+          if (opts->jobs == 0)
+            opts->jobs = get_hardware_jobs ();
+        }
+      else if (strcmp (argv[n], "--xrefs") == 0)
+        opts->xrefs = true;
+      else if (strncmp (argv[n], "--db=", 5) == 0 and argv[n][5] != '\0')
+        opts->db_fname = argv[n] + 5;
+      else if (strncmp (argv[n], "--signatures=", 13) == 0
+               and argv[n][13] != '\0')
+        opts->sig_fname = argv[n] + 13;
+      else if (strncmp (argv[n], "--make-signatures=", 18) == 0
+               and argv[n][18] != '\0')
+        opts->make_sig_fname = argv[n] + 18;
+      else if (strncmp (argv[n], "--output=", 9) == 0 and argv[n][9] != '\0')
+        opts->out_fname = argv[n] + 9;
+      else if (strncmp (argv[n], "--export=", 9) == 0 and argv[n][9] != '\0')
+        opts->export_fname = argv[n] + 9;
+      else if (strcmp (argv[n], "--export-format=jsonl") == 0)
+        opts->export_format = Exporter::JSON_LINES;
+      else if (strcmp (argv[n], "--export-format=binary") == 0)
+        opts->export_format = Exporter::BINARY;
+      else if (strncmp (argv[n], "--diff=", 7) == 0 and argv[n][7] != '\0')
+        opts->diff_fname = argv[n] + 7;
+      else if (strcmp (argv[n], "--split=object") == 0)
+        {
+          opts->split = true;
+          opts->split_functions = 0;
+        }
+      else if (strncmp (argv[n], "--split=", 8) == 0)
+        {
+          char *end;
+
+          opts->split = true;
+          opts->split_functions = strtoul (argv[n] + 8, &end, 10);
+          if (end == argv[n] + 8 or *end != '\0'
+              or opts->split_functions == 0)
+            return false;
+        }
+      else if (argv[n][0] == '-' or opts->fname != NULL)
+        return false;
+      else
+        opts->fname = argv[n];
+    }
+
+  /* Parts are named after the output file */
+  if (opts->split and opts->out_fname == NULL)
+    return false;
+
+  return (opts->fname != NULL);
 }
 
 int
 main (int argc, char **argv)
 {
-  if (argc < 2)
+  ProgramOptions opts;
+
+  if (!parse_options (argc, argv, &opts))
     {
-      std::cerr << "Usage: " << argv[0] << " [main.exe]\n";
+      std::cerr << "Usage: " << argv[0] << " [--syntax=att|intel]"
+                << " [--trace-order=fifo|address] [--jobs=N] [--xrefs]"
+                << " [--db=file] [--signatures=file]"
+                << " [--make-signatures=file] [--output=file]"
+                << " [--split=object|N] [--export=file|-]"
+                << " [--export-format=jsonl|binary] [--diff=old.exe]"
+                << " [main.exe]\n";
       return 1;
     }
 
   try
     {
-      main_execute(argv[1]);
+      main_execute(&opts);
     }
   catch (const std::exception &e)
     {
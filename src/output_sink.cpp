@@ -0,0 +1,210 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file output_sink.cpp
+ *     Implementation of OutputSink class.
+ * @par Purpose:
+ *     Implements buffering and number formatting of the generated text,
+ *     and writing it out to a file descriptor or to memory.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "output_sink.hpp"
+#include "error.hpp"
+
+#ifndef O_BINARY
+# define O_BINARY 0
+#endif
+
+static const char hex_digits[] = "0123456789abcdef";
+
+OutputSink::OutputSink (int fd)
+{
+  this->buffer  = new char[BUFFER_SIZE];
+  this->used    = 0;
+  this->fd      = fd;
+  this->owns_fd = false;
+  this->memory  = NULL;
+}
+
+OutputSink::OutputSink (std::string *memory)
+{
+  this->buffer  = NULL;
+  this->used    = 0;
+  this->fd      = -1;
+  this->owns_fd = false;
+  this->memory  = memory;
+}
+
+OutputSink::OutputSink (const char *fname)
+{
+  this->fd = open (fname, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0644);
+  if (this->fd < 0)
+    throw Error () << "Error creating file: " << fname;
+
+  this->buffer  = new char[BUFFER_SIZE];
+  this->used    = 0;
+  this->owns_fd = true;
+  this->memory  = NULL;
+}
+
+/** Flushes the buffer; errors past this point are lost, so flush first.
+ */
+OutputSink::~OutputSink (void)
+{
+  try
+    {
+      this->flush ();
+    }
+  catch (const Error &)
+    {
+    }
+
+  if (this->owns_fd)
+    close (this->fd);
+
+  delete [] this->buffer;
+}
+
+void
+OutputSink::write_out (const char *data, size_t len)
+{
+  ssize_t written;
+
+  if (this->memory != NULL)
+    {
+      this->memory->append (data, len);
+      return;
+    }
+
+  while (len > 0)
+    {
+      written = ::write (this->fd, data, len);
+      if (written < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          throw Error () << "Error writing output: " << strerror (errno);
+        }
+
+      data += written;
+      len  -= written;
+    }
+}
+
+void
+OutputSink::flush (void)
+{
+  size_t len;
+
+  /* Nothing is buffered for a string in memory */
+  if (this->used == 0)
+    return;
+
+  len = this->used;
+  this->used = 0;
+  this->write_out (this->buffer, len);
+}
+
+void
+OutputSink::write (const char *data, size_t len)
+{
+  if (this->memory != NULL)
+    {
+      this->memory->append (data, len);
+      return;
+    }
+
+  if (len > BUFFER_SIZE - this->used)
+    {
+      this->flush ();
+
+      /* Long text goes out directly instead of through the buffer */
+      if (len >= BUFFER_SIZE)
+        {
+          this->write_out (data, len);
+          return;
+        }
+    }
+
+  memcpy (this->buffer + this->used, data, len);
+  this->used += len;
+}
+
+void
+OutputSink::fill (char c, size_t count)
+{
+  size_t len;
+
+  if (this->memory != NULL)
+    {
+      this->memory->append (count, c);
+      return;
+    }
+
+  while (count > 0)
+    {
+      if (this->used == BUFFER_SIZE)
+        this->flush ();
+
+      len = std::min (count, (size_t) BUFFER_SIZE - this->used);
+      memset (this->buffer + this->used, c, len);
+      this->used += len;
+      count -= len;
+    }
+}
+
+void
+OutputSink::write_hex (uint32_t value, bool show_base)
+{
+  char digits[10];
+  int n = sizeof (digits);
+
+  do
+    {
+      digits[--n] = hex_digits[value & 0xf];
+      value >>= 4;
+    }
+  while (value != 0);
+
+  if (show_base and not (n == sizeof (digits) - 1 and digits[n] == '0'))
+    {
+      digits[--n] = 'x';
+      digits[--n] = '0';
+    }
+
+  this->write (digits + n, sizeof (digits) - n);
+}
+
+void
+OutputSink::write_dec (int64_t value)
+{
+  char digits[21];
+  int n = sizeof (digits);
+  uint64_t magnitude;
+
+  magnitude = (value < 0 ? -(uint64_t) value : (uint64_t) value);
+
+  do
+    {
+      digits[--n] = '0' + magnitude % 10;
+      magnitude /= 10;
+    }
+  while (magnitude != 0);
+
+  if (value < 0)
+    digits[--n] = '-';
+
+  this->write (digits + n, sizeof (digits) - n);
+}
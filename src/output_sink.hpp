@@ -0,0 +1,94 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file output_sink.hpp
+ *     Header file for output_sink.cpp, with declaration of OutputSink.
+ * @par Purpose:
+ *     Storage for OutputSink class which collects generated text in
+ *     a large buffer and writes it to a file descriptor or to memory.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#ifndef LEDISASM_OUTPUT_SINK_H
+#define LEDISASM_OUTPUT_SINK_H
+
+#include <inttypes.h>
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+/** Buffered text output without streams.
+ *
+ * Text is appended to a single buffer, with numbers formatted by hand,
+ * so no stream flags or locale are involved. The buffer is written out
+ * with write () when full and when flushed to a file descriptor, like
+ * standard output or an opened file. Text for a string in memory is
+ * appended to it directly, without the buffer.
+ *
+ * Numbers in hex are written the way a stream does with showbase set,
+ * that is "0x" before every value except zero.
+ */
+class OutputSink
+{
+protected:
+  enum
+  {
+    BUFFER_SIZE = 1 << 20
+  };
+
+  char        *buffer;
+  size_t       used;
+  int          fd;
+  bool         owns_fd;
+  std::string *memory;
+
+protected:
+  void write_out (const char *data, size_t len);
+
+private:
+  OutputSink (const OutputSink &other);
+  OutputSink &operator= (const OutputSink &other);
+
+public:
+  explicit OutputSink (int fd);
+  explicit OutputSink (std::string *memory);
+  explicit OutputSink (const char *fname);
+  ~OutputSink (void);
+
+  void flush (void);
+
+  void put (char c)
+  {
+    if (this->memory != NULL)
+      {
+        this->memory->push_back (c);
+        return;
+      }
+
+    if (this->used == BUFFER_SIZE)
+      this->flush ();
+
+    this->buffer[this->used++] = c;
+  }
+
+  void write (const char *data, size_t len);
+  void write (const std::string &str)
+  {
+    this->write (str.data (), str.size ());
+  }
+  void write (const char *str)
+  {
+    this->write (str, strlen (str));
+  }
+
+  void fill (char c, size_t count);
+  void write_hex (uint32_t value, bool show_base = true);
+  void write_dec (int64_t value);
+};
+
+#endif // LEDISASM_OUTPUT_SINK_H
@@ -0,0 +1,172 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file parallel.cpp
+ *     Implementation of parallel loop helper.
+ * @par Purpose:
+ *     Implements a work stealing loop over a range of indices. Every
+ *     worker starts with an equal part of the range; a worker which runs
+ *     out of work takes half of the remaining work of the busiest one.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "parallel.hpp"
+
+struct WorkRange
+{
+  std::mutex lock;
+  size_t     begin;
+  size_t     end;
+};
+
+static bool
+take_work (WorkRange *range, size_t *index)
+{
+  std::lock_guard<std::mutex> guard (range->lock);
+
+  if (range->begin >= range->end)
+    return false;
+
+  *index = range->begin++;
+  return true;
+}
+
+static bool
+steal_work (std::vector<WorkRange> *ranges, unsigned int worker)
+{
+  WorkRange *own;
+  WorkRange *victim;
+  size_t best;
+  size_t left;
+  size_t half;
+  size_t begin;
+  size_t end;
+  size_t n;
+
+  own    = &(*ranges)[worker];
+  victim = NULL;
+  best   = 0;
+
+  for (n = 0; n < ranges->size (); n++)
+    {
+      std::lock_guard<std::mutex> guard ((*ranges)[n].lock);
+
+      left = (*ranges)[n].end - (*ranges)[n].begin;
+      if (n != worker and left > best)
+        {
+          best   = left;
+          victim = &(*ranges)[n];
+        }
+    }
+
+  if (victim == NULL)
+    return false;
+
+  {
+    std::lock_guard<std::mutex> guard (victim->lock);
+
+    /* The victim may have progressed since it was chosen */
+    left = victim->end - victim->begin;
+    if (left == 0)
+      return true;
+
+    half  = (left + 1) / 2;
+    begin = victim->end - half;
+    end   = victim->end;
+    victim->end = begin;
+  }
+
+  /* Never hold two locks at once, thieves could block each other */
+  std::lock_guard<std::mutex> guard (own->lock);
+  own->begin = begin;
+  own->end   = end;
+
+  return true;
+}
+
+static void
+run_worker (std::vector<WorkRange> *ranges, unsigned int worker,
+            const ParallelFunc *func, std::exception_ptr *error)
+{
+  size_t index;
+
+  try
+    {
+      do
+        {
+          while (take_work (&(*ranges)[worker], &index))
+            (*func) (index, worker);
+        }
+      while (steal_work (ranges, worker));
+    }
+  catch (...)
+    {
+      *error = std::current_exception ();
+    }
+}
+
+unsigned int
+get_hardware_jobs (void)
+{
+  unsigned int jobs;
+
+  jobs = std::thread::hardware_concurrency ();
+  if (jobs == 0)
+    jobs = 1;
+
+  return jobs;
+}
+
+/** Calls func for every index from 0 to count - 1.
+ *
+ * The calls are spread over at most jobs threads, including the calling
+ * one; worker is the number of thread making the call, from 0 to jobs - 1.
+ * Order of the calls is not defined. If any call throws, the first
+ * exception is passed on after all threads finished.
+ */
+void
+parallel_for (size_t count, unsigned int jobs, const ParallelFunc &func)
+{
+  std::vector<WorkRange> ranges (jobs);
+  std::vector<std::exception_ptr> errors (jobs);
+  std::vector<std::thread> threads;
+  size_t n;
+
+  if (jobs <= 1 or count <= 1)
+    {
+      for (n = 0; n < count; n++)
+        func (n, 0);
+      return;
+    }
+
+  for (n = 0; n < jobs; n++)
+    {
+      ranges[n].begin = count * n / jobs;
+      ranges[n].end   = count * (n + 1) / jobs;
+    }
+
+  for (n = 1; n < jobs; n++)
+    threads.push_back (std::thread (run_worker, &ranges, n, &func,
+                                    &errors[n]));
+
+  run_worker (&ranges, 0, &func, &errors[0]);
+
+  for (n = 0; n < threads.size (); n++)
+    threads[n].join ();
+
+  for (n = 0; n < jobs; n++)
+    {
+      if (errors[n])
+        std::rethrow_exception (errors[n]);
+    }
+}
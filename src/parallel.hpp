@@ -0,0 +1,28 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file parallel.hpp
+ *     Header file for parallel.cpp, with declaration of parallel loop helper.
+ * @par Purpose:
+ *     Declares a helper which spreads independent work items over
+ *     a number of threads.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#ifndef LEDISASM_PARALLEL_H
+#define LEDISASM_PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+
+typedef std::function<void (size_t index, unsigned int worker)> ParallelFunc;
+
+unsigned int get_hardware_jobs (void);
+void parallel_for (size_t count, unsigned int jobs, const ParallelFunc &func);
+
+#endif // LEDISASM_PARALLEL_H
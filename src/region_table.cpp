@@ -0,0 +1,220 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file region_table.cpp
+ *     Implementation of RegionTable class.
+ * @par Purpose:
+ *     Implements storage of regions sorted by address and the split and
+ *     merge of regions when a new one is carved out of an existing one.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#include <algorithm>
+#include <cassert>
+
+#include "region_table.hpp"
+
+RegionTable::const_iterator::const_iterator (void)
+{
+  this->table = NULL;
+  this->index = 0;
+}
+
+RegionTable::const_iterator::const_iterator (const RegionTable *table,
+                                             size_t index)
+{
+  this->table = table;
+  this->index = index;
+}
+
+const Region &
+RegionTable::const_iterator::operator* (void) const
+{
+  return this->table->at (this->index);
+}
+
+const Region *
+RegionTable::const_iterator::operator-> (void) const
+{
+  return &this->table->at (this->index);
+}
+
+RegionTable::const_iterator &
+RegionTable::const_iterator::operator++ (void)
+{
+  this->index++;
+  return *this;
+}
+
+bool
+RegionTable::const_iterator::operator== (const const_iterator &other) const
+{
+  return (this->index == other.index);
+}
+
+bool
+RegionTable::const_iterator::operator!= (const const_iterator &other) const
+{
+  return (this->index != other.index);
+}
+
+/* Returns index of the first region starting after given address. */
+size_t
+RegionTable::upper_bound (uint32_t address) const
+{
+  size_t low;
+  size_t high;
+  size_t mid;
+
+  low  = 0;
+  high = this->size ();
+
+  while (low < high)
+    {
+      mid = low + (high - low) / 2;
+
+      if (this->at (mid).get_address () <= address)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+
+  return low;
+}
+
+size_t
+RegionTable::size (void) const
+{
+  return this->entries.size ();
+}
+
+bool
+RegionTable::empty (void) const
+{
+  return (this->size () == 0);
+}
+
+void
+RegionTable::clear (void)
+{
+  this->entries.clear ();
+}
+
+RegionTable::const_iterator
+RegionTable::begin (void) const
+{
+  return const_iterator (this, 0);
+}
+
+RegionTable::const_iterator
+RegionTable::end (void) const
+{
+  return const_iterator (this, this->size ());
+}
+
+const Region &
+RegionTable::at (size_t index) const
+{
+  return this->entries[index];
+}
+
+size_t
+RegionTable::index_of (const Region *reg) const
+{
+  size_t index;
+
+  index = reg - this->entries.data ();
+  assert (index < this->entries.size ());
+
+  return index;
+}
+
+/** Adds a region, carving it out of the region it falls within.
+ *
+ * The rest of the existing region is kept before and after the new one,
+ * and the new region is merged with neighbours of the same type.
+ * A region outside of all others is added as it is.
+ */
+void
+RegionTable::insert (const Region &reg)
+{
+  Region pieces[3];
+  Region parent;
+  uint32_t start;
+  size_t end;
+  size_t first;
+  size_t last;
+  size_t count;
+
+  /* Regions come in address order when the table is rebuilt */
+  if (this->entries.empty ()
+      or this->entries.back ().get_end_address () <= reg.get_address ())
+    {
+      this->entries.push_back (reg);
+      return;
+    }
+
+  first = this->upper_bound (reg.get_address ());
+
+  if (first == 0
+      or !this->at (first - 1).contains_address (reg.get_address ()))
+    {
+      this->entries.insert (this->entries.begin () + first, reg);
+      return;
+    }
+
+  first--;
+  parent = this->at (first);
+  assert (reg.get_end_address () <= parent.get_end_address ());
+
+  if (reg.get_type () == parent.get_type ())
+    return;
+
+  last  = first + 1;
+  start = reg.get_address ();
+  end   = reg.get_end_address ();
+  count = 0;
+
+  if (start != parent.get_address ())
+    pieces[count++] = Region (parent.get_address (),
+                              start - parent.get_address (),
+                              parent.get_type ());
+  else if (first > 0
+           and this->at (first - 1).get_type () == reg.get_type ()
+           and this->at (first - 1).get_end_address () == start)
+    {
+      first--;
+      start = this->at (first).get_address ();
+    }
+
+  if (end == parent.get_end_address () and last < this->size ()
+      and this->at (last).get_type () == reg.get_type ()
+      and this->at (last).get_address () == end)
+    {
+      end = this->at (last).get_end_address ();
+      last++;
+    }
+
+  pieces[count++] = Region (start, end - start, reg.get_type ());
+
+  if (reg.get_end_address () != parent.get_end_address ())
+    pieces[count++] = Region (reg.get_end_address (),
+                              (parent.get_end_address ()
+                               - reg.get_end_address ()),
+                              parent.get_type ());
+
+  /* Pieces take the place of the replaced entries */
+  if (count < last - first)
+    this->entries.erase (this->entries.begin () + first + count,
+                         this->entries.begin () + last);
+  else if (count > last - first)
+    this->entries.insert (this->entries.begin () + last,
+                          count - (last - first), Region ());
+
+  std::copy (pieces, pieces + count, this->entries.begin () + first);
+}
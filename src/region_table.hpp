@@ -0,0 +1,81 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file region_table.hpp
+ *     Header file for region_table.cpp, with declaration of RegionTable class.
+ * @par Purpose:
+ *     Storage for RegionTable class, a sorted container of non-overlapping
+ *     regions which supports carving a region out of another one.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#ifndef LEDISASM_REGION_TABLE_H
+#define LEDISASM_REGION_TABLE_H
+
+#include <inttypes.h>
+#include <cstddef>
+#include <vector>
+
+#include "regions.hpp"
+
+/** Regions sorted by address, in a flat vector.
+ *
+ * The table is rebuilt from the shadow map in one sweep, which inserts
+ * regions in address order, so insertion is an append. Iteration and
+ * access by index are plain array accesses. A region added inside an
+ * existing one is carved out of it: the existing region is split around
+ * it, and the new region is merged with neighbours of the same type.
+ * Carving only moves the entries after the changed ones, in one block.
+ *
+ * Pointers to regions are valid only until the table is modified.
+ */
+class RegionTable
+{
+public:
+  /** Cursor over regions in address order. */
+  class const_iterator
+  {
+  protected:
+    friend class RegionTable;
+
+    const RegionTable *table;
+    size_t             index;
+
+    const_iterator (const RegionTable *table, size_t index);
+
+  public:
+    const_iterator (void);
+
+    const Region &operator* (void) const;
+    const Region *operator-> (void) const;
+    const_iterator &operator++ (void);
+    bool operator== (const const_iterator &other) const;
+    bool operator!= (const const_iterator &other) const;
+  };
+
+protected:
+  std::vector<Region> entries;
+
+protected:
+  size_t upper_bound (uint32_t address) const;
+
+public:
+  size_t size (void) const;
+  bool   empty (void) const;
+  void   clear (void);
+
+  const_iterator begin (void) const;
+  const_iterator end (void) const;
+
+  const Region &at (size_t index) const;
+  size_t index_of (const Region *reg) const;
+
+  void insert (const Region &reg);
+};
+
+#endif // LEDISASM_REGION_TABLE_H
@@ -38,6 +38,16 @@ Region::Region (const Region &other)
   *this = other;
 }
 
+Region &
+Region::operator= (const Region &other)
+{
+  this->address = other.address;
+  this->size    = other.size;
+  this->type    = other.type;
+
+  return *this;
+}
+
 uint32_t
 Region::get_address (void) const
 {
@@ -85,6 +95,36 @@ operator<< (std::ostream &os, Region::Type type)
     case Region::VTABLE:
       os << "vtable";
       break;
+    case Region::POINTER:
+      os << "pointer";
+      break;
+    case Region::POINTER_ARRAY:
+      os << "pointer array";
+      break;
+    case Region::ZERO_FILL:
+      os << "zero fill";
+      break;
+    case Region::C_STRING:
+      os << "c string";
+      break;
+    case Region::ASCII:
+      os << "ascii";
+      break;
+    case Region::FLOAT_TABLE:
+      os << "float table";
+      break;
+    case Region::DOUBLE_TABLE:
+      os << "double table";
+      break;
+    case Region::INT16_TABLE:
+      os << "int16 table";
+      break;
+    case Region::INT32_TABLE:
+      os << "int32 table";
+      break;
+    case Region::BYTES:
+      os << "bytes";
+      break;
     default:
       os << "(unknown " << std::dec << type << ")";
       break;
@@ -41,7 +41,18 @@ public:
     UNKNOWN,
     CODE,
     DATA,
-    VTABLE
+    VTABLE,
+    /* Kinds of data found within DATA regions by DataTypeTable */
+    POINTER,
+    POINTER_ARRAY,
+    ZERO_FILL,
+    C_STRING,
+    ASCII,
+    FLOAT_TABLE,
+    DOUBLE_TABLE,
+    INT16_TABLE,
+    INT32_TABLE,
+    BYTES
   };
 
 protected:
@@ -54,6 +65,8 @@ public:
   Region (void);
   Region (const Region &other);
 
+  Region &operator= (const Region &other);
+
   uint32_t get_address (void) const;
   size_t   get_end_address (void) const;
   Region::Type get_type (void) const;
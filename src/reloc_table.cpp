@@ -0,0 +1,179 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file reloc_table.cpp
+ *     Implementation of RelocTable class.
+ * @par Purpose:
+ *     Implements classification of relocation targets, run in parallel
+ *     over all targets of the executable.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#include <algorithm>
+
+#include "reloc_table.hpp"
+#include "image.hpp"
+#include "le.hpp"
+#include "parallel.hpp"
+#include "util.hpp"
+
+/** Fills in kind and vtable run of a target.
+ *
+ * The run ends at the next target, if it is non-zero, or at end of
+ * the object; limits given by analysis state are left to the caller.
+ */
+void
+RelocTable::classify (const Image *image,
+                      const std::vector<std::vector<uint32_t> > &positions,
+                      uint32_t next, Target *target)
+{
+  std::vector<uint32_t>::const_iterator pos;
+  const std::vector<uint32_t> *relocs;
+  const Image::Object *obj;
+  const uint8_t *data_ptr;
+  uint32_t start;
+  size_t size;
+  size_t off;
+
+  start = target->address;
+  target->run_size = 0;
+
+  obj = image->get_object_at_address (start);
+  if (obj == NULL)
+    {
+      target->kind = UNMAPPED;
+      return;
+    }
+
+  if (!obj->is_executable ())
+    {
+      target->kind = DATA_POINTER;
+      return;
+    }
+
+  size = obj->get_base_address () + obj->get_data ()->size () - start;
+  if (next > start)
+    size = std::min<size_t> (size, next - start);
+
+  relocs = &positions[obj->get_index ()];
+  pos = std::lower_bound (relocs->begin (), relocs->end (), start);
+  data_ptr = obj->get_data_at (start);
+
+  for (off = 0; off + 4 <= size; off += 4)
+    {
+      if (pos != relocs->end () and *pos == start + off)
+        ++pos;
+      else if (read_le<uint32_t> (data_ptr + off) != 0)
+        break;
+    }
+
+  if (off > 0)
+    {
+      target->kind = VTABLE_RUN;
+      target->run_size = off;
+      return;
+    }
+
+  pos = std::lower_bound (relocs->begin (), relocs->end (), start);
+  if (pos != relocs->begin () and *(pos - 1) + 4 > start)
+    target->kind = INTERIOR_POINTER;
+  else
+    target->kind = FUNCTION_POINTER;
+}
+
+void
+RelocTable::build (const LinearExecutable *le, const Image *image,
+                   unsigned int jobs)
+{
+  const LinearExecutable::AddressSet *addresses;
+  LinearExecutable::AddressSet::const_iterator itr;
+  std::vector<std::vector<uint32_t> > positions;
+  const LEFM *fixups;
+  LEFM::const_iterator fitr;
+  const Image::Object *obj;
+  Target target;
+  size_t n;
+
+  /* Absolute addresses of relocated dwords, by object */
+  positions.resize (image->get_object_count ());
+
+  for (n = 0; n < image->get_object_count (); n++)
+    {
+      obj = image->get_object (n);
+      fixups = le->get_fixups_for_object (n);
+      positions[n].reserve (fixups->size ());
+
+      for (fitr = fixups->begin (); fitr != fixups->end (); ++fitr)
+        positions[n].push_back (obj->get_base_address () + fitr->first);
+    }
+
+  addresses = le->get_fixup_addresses ();
+  this->targets.clear ();
+  this->targets.reserve (addresses->size ());
+
+  for (itr = addresses->begin (); itr != addresses->end (); ++itr)
+    {
+      target.address  = *itr;
+      target.run_size = 0;
+      target.kind     = UNMAPPED;
+      this->targets.push_back (target);
+    }
+
+  parallel_for (this->targets.size (), jobs,
+                [&] (size_t index, unsigned int worker)
+                {
+                  uint32_t next = 0;
+
+                  (void) worker;
+
+                  if (index + 1 < this->targets.size ())
+                    next = this->targets[index + 1].address;
+
+                  classify (image, positions, next,
+                            &this->targets[index]);
+                });
+}
+
+void
+RelocTable::clear (void)
+{
+  this->targets.clear ();
+}
+
+size_t
+RelocTable::size (void) const
+{
+  return this->targets.size ();
+}
+
+bool
+RelocTable::empty (void) const
+{
+  return this->targets.empty ();
+}
+
+const RelocTable::Target &
+RelocTable::at (size_t n) const
+{
+  return this->targets[n];
+}
+
+/* Returns index of the first target at or after given address. */
+size_t
+RelocTable::lower_bound (uint32_t address) const
+{
+  std::vector<Target>::const_iterator itr;
+
+  itr = std::lower_bound (this->targets.begin (), this->targets.end (),
+                          address,
+                          [] (const Target &target, uint32_t addr)
+                          {
+                            return target.address < addr;
+                          });
+  return itr - this->targets.begin ();
+}
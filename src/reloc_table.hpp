@@ -0,0 +1,71 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file reloc_table.hpp
+ *     Header file for reloc_table.cpp, with declaration of RelocTable class.
+ * @par Purpose:
+ *     Storage for RelocTable class which classifies relocation targets
+ *     by what can be told from the image alone, before analysis.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#ifndef LEDISASM_RELOC_TABLE_H
+#define LEDISASM_RELOC_TABLE_H
+
+#include <inttypes.h>
+#include <cstddef>
+#include <vector>
+
+class LinearExecutable;
+class Image;
+
+/** Relocation targets in address order, each with its candidate kind.
+ *
+ * Classification only reads the image and relocations, so it is done
+ * for all targets in parallel; the analyser then commits decisions
+ * based on it and the current state of analysis.
+ */
+class RelocTable
+{
+public:
+  enum Kind
+  {
+    UNMAPPED,          /* outside of all objects */
+    DATA_POINTER,      /* into a non-executable object */
+    FUNCTION_POINTER,  /* into an executable object */
+    INTERIOR_POINTER,  /* into the middle of a relocated dword */
+    VTABLE_RUN         /* at dwords which are zero or relocated */
+  };
+
+  struct Target
+  {
+    uint32_t address;
+    uint32_t run_size;  /* bytes of a vtable run, up to the next target */
+    uint8_t  kind;
+  };
+
+protected:
+  std::vector<Target> targets;
+
+protected:
+  static void classify (const Image *image,
+                        const std::vector<std::vector<uint32_t> > &positions,
+                        uint32_t next, Target *target);
+
+public:
+  void build (const LinearExecutable *le, const Image *image,
+              unsigned int jobs);
+  void clear (void);
+
+  size_t size (void) const;
+  bool   empty (void) const;
+  const Target &at (size_t n) const;
+  size_t lower_bound (uint32_t address) const;
+};
+
+#endif // LEDISASM_RELOC_TABLE_H
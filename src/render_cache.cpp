@@ -0,0 +1,89 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file render_cache.cpp
+ *     Implementation of RenderCache class.
+ * @par Purpose:
+ *     Implements keying and storage of instruction text templates.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#include "decoder.hpp"
+#include "render_cache.hpp"
+
+RenderCache::RenderCache (void)
+{
+  this->hits   = 0;
+  this->misses = 0;
+}
+
+bool
+RenderCache::is_hole_marker (char c)
+{
+  /* Formatted text is printable, so any control character is a marker */
+  return ((unsigned char) c < 0x20);
+}
+
+void
+RenderCache::make_key (const DecodedInstruction *inst, const void *data,
+                       std::string *key)
+{
+  const Operand *op;
+  uint8_t holes;
+  size_t n;
+
+  key->assign ((const char *) data, inst->size);
+  holes = 0;
+
+  for (n = 0; n < inst->operand_count; n++)
+    {
+      op = &inst->operands[n];
+      if (op->hole == 0)
+        continue;
+
+      key->replace (op->field_offset, op->field_size, op->field_size, '\0');
+      holes |= 1 << n;
+    }
+
+  /* Same bytes with and without a reloc must not share a template */
+  key->push_back ((char) holes);
+}
+
+const RenderCache::Template *
+RenderCache::find (const std::string &key)
+{
+  TemplateMap::const_iterator itr;
+
+  itr = this->templates.find (key);
+  if (itr == this->templates.end ())
+    {
+      this->misses++;
+      return NULL;
+    }
+
+  this->hits++;
+  return &itr->second;
+}
+
+RenderCache::Template *
+RenderCache::insert (const std::string &key)
+{
+  return &this->templates[key];
+}
+
+size_t
+RenderCache::get_hits (void) const
+{
+  return this->hits;
+}
+
+size_t
+RenderCache::get_misses (void) const
+{
+  return this->misses;
+}
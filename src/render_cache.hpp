@@ -0,0 +1,64 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file render_cache.hpp
+ *     Header file for render_cache.cpp, with declaration of RenderCache class.
+ * @par Purpose:
+ *     Storage for RenderCache class which remembers symbolised text of
+ *     instructions, so that repeated byte patterns are formatted only once.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#ifndef LEDISASM_RENDER_CACHE_H
+#define LEDISASM_RENDER_CACHE_H
+
+#include <inttypes.h>
+#include <string>
+#include <unordered_map>
+
+struct DecodedInstruction;
+
+/** Cache of instruction text templates.
+ *
+ * Templates are keyed by the instruction bytes, with relocated and
+ * PC-relative fields zeroed, as these differ between otherwise identical
+ * instructions. Such fields are marked as holes within the decoded
+ * operands, and the template text contains a marker character in place
+ * of each of them; the value is symbolised separately for every
+ * occurrence and spliced into the template.
+ */
+class RenderCache
+{
+public:
+  struct Template
+  {
+    std::string text;     /* symbolised text with hole markers */
+    bool        warning;  /* text needs the missing label comment */
+  };
+
+protected:
+  typedef std::unordered_map<std::string, Template> TemplateMap;
+
+  TemplateMap templates;
+  size_t hits;
+  size_t misses;
+
+public:
+  RenderCache (void);
+
+  static bool is_hole_marker (char c);
+  static void make_key (const DecodedInstruction *inst, const void *data,
+                        std::string *key);
+
+  const Template *find (const std::string &key);
+  Template *insert (const std::string &key);
+  size_t get_hits (void) const;
+  size_t get_misses (void) const;
+};
+
+#endif // LEDISASM_RENDER_CACHE_H
@@ -0,0 +1,374 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file shadow_map.cpp
+ *     Implementation of ShadowMap class.
+ * @par Purpose:
+ *     Implements per-byte flags of object memory, and conversion of
+ *     the flags into regions.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#include <algorithm>
+#include <cassert>
+
+#include "database.hpp"
+#include "error.hpp"
+#include "region_table.hpp"
+#include "shadow_map.hpp"
+
+const ShadowMap::Object *
+ShadowMap::get_object_at_address (uint32_t addr) const
+{
+  size_t n;
+
+  for (n = 0; n < this->objects.size (); n++)
+    {
+      if (addr - this->objects[n].base_address < this->objects[n].size)
+        return &this->objects[n];
+    }
+
+  return NULL;
+}
+
+/** Returns writable flags from addr on, unsharing their page.
+ *
+ * The size is reduced to the part of the range within that page.
+ */
+uint8_t *
+ShadowMap::edit_flags_at (uint32_t addr, size_t *size)
+{
+  Object *obj;
+  size_t offset;
+
+  obj = (Object *) this->get_object_at_address (addr);
+  assert (obj != NULL);
+
+  offset = addr - obj->base_address;
+  assert (offset + *size <= obj->size);
+
+  *size = std::min<size_t> (*size, PAGE_SIZE - (offset & PAGE_MASK));
+  return &obj->pages[offset >> PAGE_SHIFT].edit ()->flags[offset & PAGE_MASK];
+}
+
+uint8_t
+ShadowMap::type_to_flags (Region::Type type)
+{
+  switch (type)
+    {
+    case Region::CODE:
+      return CODE;
+    case Region::DATA:
+      return DATA;
+    case Region::VTABLE:
+      return VTABLE;
+    default:
+      return 0;
+    }
+}
+
+Region::Type
+ShadowMap::flags_to_type (uint8_t flags)
+{
+  switch (flags & TYPE_MASK)
+    {
+    case CODE:
+      return Region::CODE;
+    case DATA:
+      return Region::DATA;
+    case VTABLE:
+      return Region::VTABLE;
+    default:
+      return Region::UNKNOWN;
+    }
+}
+
+void
+ShadowMap::add_object (uint32_t base_address, size_t size, Region::Type type)
+{
+  Object obj;
+  Page page;
+
+  std::fill (page.flags, page.flags + PAGE_SIZE, type_to_flags (type));
+
+  obj.base_address = base_address;
+  obj.size         = size;
+  obj.initial_type = type;
+  obj.pages.assign ((size + PAGE_MASK) >> PAGE_SHIFT, CowPtr<Page> (page));
+  this->objects.push_back (obj);
+}
+
+void
+ShadowMap::clear (void)
+{
+  this->objects.clear ();
+}
+
+bool
+ShadowMap::contains_address (uint32_t addr) const
+{
+  return (this->get_object_at_address (addr) != NULL);
+}
+
+uint8_t
+ShadowMap::get_flags (uint32_t addr) const
+{
+  const Object *obj;
+  size_t offset;
+
+  obj = this->get_object_at_address (addr);
+  if (obj == NULL)
+    return 0;
+
+  offset = addr - obj->base_address;
+  return obj->pages[offset >> PAGE_SHIFT]->flags[offset & PAGE_MASK];
+}
+
+Region::Type
+ShadowMap::get_type (uint32_t addr) const
+{
+  return flags_to_type (this->get_flags (addr));
+}
+
+bool
+ShadowMap::is_instruction_start (uint32_t addr) const
+{
+  return ((this->get_flags (addr) & CODE_START) != 0);
+}
+
+/** Returns count of bytes from addr on, up to max_length, which are
+ * of the same type as the byte at addr and within the same object.
+ */
+size_t
+ShadowMap::get_run_length (uint32_t addr, size_t max_length) const
+{
+  const Object *obj;
+  const uint8_t *flags;
+  size_t offset;
+  size_t n;
+  uint8_t type;
+
+  obj = this->get_object_at_address (addr);
+  if (obj == NULL)
+    return 0;
+
+  offset = addr - obj->base_address;
+  max_length = std::min<size_t> (max_length, obj->size - offset);
+  type  = this->get_flags (addr) & TYPE_MASK;
+  flags = NULL;
+
+  for (n = 1; n < max_length; n++)
+    {
+      if (flags == NULL or ((offset + n) & PAGE_MASK) == 0)
+        flags = obj->pages[(offset + n) >> PAGE_SHIFT]->flags;
+
+      if ((flags[(offset + n) & PAGE_MASK] & TYPE_MASK) != type)
+        break;
+    }
+
+  return std::min<size_t> (n, max_length);
+}
+
+void
+ShadowMap::set_type (uint32_t addr, size_t size, Region::Type type)
+{
+  uint8_t *flags;
+  uint8_t type_flags;
+  size_t length;
+  size_t n;
+
+  type_flags = type_to_flags (type);
+
+  for (; size > 0; addr += length, size -= length)
+    {
+      length = size;
+      flags  = this->edit_flags_at (addr, &length);
+
+      for (n = 0; n < length; n++)
+        flags[n] = (flags[n] & MARK_MASK) | type_flags;
+    }
+}
+
+void
+ShadowMap::set_instruction (uint32_t addr, size_t size)
+{
+  size_t length;
+
+  /* Setting the type also clears starts of overlapped instructions */
+  this->set_type (addr, size, Region::CODE);
+
+  length = 1;
+  *this->edit_flags_at (addr, &length) |= CODE_START;
+}
+
+void
+ShadowMap::set_flag (uint32_t addr, Flags flag)
+{
+  size_t length;
+
+  /* Avoid unsharing the page when nothing changes */
+  if ((this->get_flags (addr) & flag) == flag)
+    return;
+
+  length = 1;
+  *this->edit_flags_at (addr, &length) |= flag;
+}
+
+/* Gives bytes back their initial type, dropping all marks. */
+void
+ShadowMap::reset (uint32_t addr, size_t size)
+{
+  const Object *obj;
+  uint8_t *flags;
+  uint8_t type_flags;
+  size_t length;
+
+  obj = this->get_object_at_address (addr);
+  type_flags = type_to_flags (obj->initial_type);
+
+  for (; size > 0; addr += length, size -= length)
+    {
+      length = size;
+      flags  = this->edit_flags_at (addr, &length);
+      std::fill (flags, flags + length, type_flags);
+    }
+}
+
+void
+ShadowMap::build_regions (RegionTable *table) const
+{
+  const Object *obj;
+  size_t start;
+  size_t n;
+  size_t k;
+
+  table->clear ();
+
+  for (k = 0; k < this->objects.size (); k++)
+    {
+      obj   = &this->objects[k];
+      start = 0;
+
+      if (obj->size == 0)
+        {
+          table->insert (Region (obj->base_address, 0, obj->initial_type));
+          continue;
+        }
+
+      while (start < obj->size)
+        {
+          n = this->get_run_length (obj->base_address + start,
+                                    obj->size - start);
+          table->insert (Region (obj->base_address + start, n,
+                                 this->get_type (obj->base_address + start)));
+          start += n;
+        }
+    }
+}
+
+/** Writes the objects, with their flags as runs of equal bytes.
+ */
+void
+ShadowMap::save (DatabaseWriter *db) const
+{
+  struct Run
+  {
+    uint32_t length;
+    uint8_t  flags;
+  };
+
+  std::vector<Run> runs;
+  const Object *obj;
+  const Page *page;
+  uint32_t offset;
+  Run run;
+  size_t n;
+  size_t r;
+
+  db->put_u32 (this->objects.size ());
+
+  for (n = 0; n < this->objects.size (); n++)
+    {
+      obj = &this->objects[n];
+      runs.clear ();
+
+      for (offset = 0; offset < obj->size; offset++)
+        {
+          page = obj->pages[offset >> PAGE_SHIFT].get ();
+          run.flags  = page->flags[offset & PAGE_MASK];
+          run.length = 1;
+
+          if (!runs.empty () and runs.back ().flags == run.flags)
+            runs.back ().length++;
+          else
+            runs.push_back (run);
+        }
+
+      db->put_u32 (obj->base_address);
+      db->put_u32 (obj->size);
+      db->put_u8 (obj->initial_type);
+      db->put_u32 (runs.size ());
+
+      for (r = 0; r < runs.size (); r++)
+        {
+          db->put_u32 (runs[r].length);
+          db->put_u8 (runs[r].flags);
+        }
+    }
+}
+
+/** Reads flags written by save () into the same objects.
+ */
+void
+ShadowMap::load (DatabaseReader *db)
+{
+  uint32_t count;
+  uint32_t length;
+  uint32_t offset;
+  uint8_t flags;
+  uint8_t *data;
+  size_t size;
+  size_t n;
+  Object *obj;
+
+  if (db->get_u32 () != this->objects.size ())
+    throw Error () << "Analysis database does not match the executable";
+
+  for (n = 0; n < this->objects.size (); n++)
+    {
+      obj = &this->objects[n];
+
+      if (db->get_u32 () != obj->base_address
+          or db->get_u32 () != obj->size
+          or db->get_u8 () != obj->initial_type)
+        throw Error () << "Analysis database does not match the executable";
+
+      offset = 0;
+
+      for (count = db->get_u32 (); count > 0; count--)
+        {
+          length = db->get_u32 ();
+          flags  = db->get_u8 ();
+
+          if (length > obj->size - offset)
+            throw Error () << "Analysis database is corrupt";
+
+          while (length > 0)
+            {
+              size = length;
+              data = this->edit_flags_at (obj->base_address + offset, &size);
+              std::fill (data, data + size, flags);
+              offset += size;
+              length -= size;
+            }
+        }
+
+      if (offset != obj->size)
+        throw Error () << "Analysis database is corrupt";
+    }
+}
@@ -0,0 +1,114 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file shadow_map.hpp
+ *     Header file for shadow_map.cpp, with declaration of ShadowMap class.
+ * @par Purpose:
+ *     Storage for ShadowMap class which keeps a few flag bits for every
+ *     byte of every object, telling what the byte was recognised as.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#ifndef LEDISASM_SHADOW_MAP_H
+#define LEDISASM_SHADOW_MAP_H
+
+#include <inttypes.h>
+#include <cstddef>
+#include <vector>
+
+#include "cow_ptr.hpp"
+#include "regions.hpp"
+
+class DatabaseReader;
+class DatabaseWriter;
+class RegionTable;
+
+/** Per-byte ownership of the object memory.
+ *
+ * Every byte has at most one of CODE, DATA or VTABLE flags set, which
+ * gives the type of region it belongs to; bytes with none of them are
+ * unknown. First bytes of traced instructions also have CODE_START,
+ * addresses where tracing was started have TRACED, addresses
+ * which were put into the trace queue have QUEUED, and relocation
+ * targets guessed to be functions have GUESSED.
+ *
+ * Regions are maximal runs of bytes of the same type within an object,
+ * so the region table can be built by a single sweep over the flags.
+ *
+ * Flags are kept in pages shared between copies of the map until
+ * written, so a copy costs only a pointer per page, and pages never
+ * written after add_object () share one buffer.
+ */
+class ShadowMap
+{
+public:
+  enum Flags
+  {
+    CODE_START = 0x01,
+    CODE       = 0x02,
+    DATA       = 0x04,
+    VTABLE     = 0x08,
+    TRACED     = 0x10,
+    QUEUED     = 0x20,
+    GUESSED    = 0x40,
+    TYPE_MASK  = CODE | DATA | VTABLE,
+    MARK_MASK  = TRACED | QUEUED | GUESSED
+  };
+
+protected:
+  enum
+  {
+    PAGE_SHIFT = 12,
+    PAGE_SIZE  = 1 << PAGE_SHIFT,
+    PAGE_MASK  = PAGE_SIZE - 1
+  };
+
+  struct Page
+  {
+    uint8_t flags[PAGE_SIZE];
+  };
+
+  struct Object
+  {
+    uint32_t             base_address;
+    uint32_t             size;
+    Region::Type         initial_type;
+    std::vector<CowPtr<Page> > pages;
+  };
+
+  std::vector<Object> objects;
+
+protected:
+  const Object *get_object_at_address (uint32_t addr) const;
+  uint8_t *edit_flags_at (uint32_t addr, size_t *size);
+
+  static uint8_t type_to_flags (Region::Type type);
+  static Region::Type flags_to_type (uint8_t flags);
+
+public:
+  void add_object (uint32_t base_address, size_t size, Region::Type type);
+  void clear (void);
+
+  bool contains_address (uint32_t addr) const;
+  uint8_t get_flags (uint32_t addr) const;
+  Region::Type get_type (uint32_t addr) const;
+  bool is_instruction_start (uint32_t addr) const;
+  size_t get_run_length (uint32_t addr, size_t max_length) const;
+
+  void set_type (uint32_t addr, size_t size, Region::Type type);
+  void set_instruction (uint32_t addr, size_t size);
+  void set_flag (uint32_t addr, Flags flag);
+  void reset (uint32_t addr, size_t size);
+
+  void build_regions (RegionTable *table) const;
+
+  void save (DatabaseWriter *db) const;
+  void load (DatabaseReader *db);
+};
+
+#endif // LEDISASM_SHADOW_MAP_H
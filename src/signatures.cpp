@@ -0,0 +1,617 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file signatures.cpp
+ *     Implementation of SignatureLibrary class.
+ * @par Purpose:
+ *     Implements loading, matching and writing of function signatures,
+ *     with relocated bytes masked.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+
+#include "signatures.hpp"
+#include "analyser.hpp"
+#include "cfg.hpp"
+#include "disassembler.hpp"
+#include "error.hpp"
+#include "label.hpp"
+
+static const uint32_t NO_NODE = 0xffffffff;
+
+/* Runs of compared bytes put into the automaton */
+static const size_t min_anchor_size = 4;
+static const size_t max_anchor_size = 16;
+
+/* Bytes of a function written as its signature */
+static const size_t min_signature_size = 8;
+static const size_t max_signature_size = 32;
+
+/* Bytes changed by a relocation */
+static const uint32_t fixup_size = 4;
+
+static int
+hex_digit (char c)
+{
+  if (c >= '0' and c <= '9')
+    return c - '0';
+
+  c = tolower (c);
+  if (c >= 'a' and c <= 'f')
+    return c - 'a' + 10;
+
+  return -1;
+}
+
+SignatureLibrary::SignatureLibrary (void)
+{
+  std::fill (this->root_next, this->root_next + 256, 0);
+}
+
+/** Adds a signature; returns false if it has no run long enough to find.
+ */
+bool
+SignatureLibrary::add (const std::string &pattern, const std::string &name)
+{
+  Signature sig;
+  size_t run;
+  size_t n;
+  int high;
+  int low;
+
+  if (pattern.size () % 2 != 0)
+    throw Error () << "Invalid signature pattern for " << name;
+
+  for (n = 0; n < pattern.size (); n += 2)
+    {
+      if (pattern[n] == '.' and pattern[n + 1] == '.')
+        {
+          sig.bytes.push_back (0);
+          sig.mask.push_back (0);
+          continue;
+        }
+
+      high = hex_digit (pattern[n]);
+      low  = hex_digit (pattern[n + 1]);
+      if (high < 0 or low < 0)
+        throw Error () << "Invalid signature pattern for " << name;
+
+      sig.bytes.push_back (high << 4 | low);
+      sig.mask.push_back (1);
+    }
+
+  sig.name = name;
+  sig.anchor = 0;
+  sig.anchor_size = 0;
+  run = 0;
+
+  for (n = 0; n < sig.bytes.size (); n++)
+    {
+      run = (sig.mask[n] != 0 ? run + 1 : 0);
+
+      if (run > sig.anchor_size)
+        {
+          sig.anchor = n + 1 - run;
+          sig.anchor_size = run;
+        }
+    }
+
+  if (sig.anchor_size < min_anchor_size)
+    return false;
+
+  sig.anchor_size = std::min (sig.anchor_size, (uint32_t) max_anchor_size);
+  this->signatures.push_back (sig);
+  return true;
+}
+
+/** Builds the automaton from a trie of the anchors of all signatures.
+ */
+void
+SignatureLibrary::build_automaton (void)
+{
+  std::vector<std::map<uint8_t, uint32_t> > children (1);
+  std::map<uint8_t, uint32_t>::const_iterator itr;
+  std::vector<std::vector<uint32_t> > ends (1);
+  std::vector<uint32_t> order;
+  const Signature *sig;
+  uint32_t node;
+  uint32_t child;
+  uint32_t fail;
+  size_t n;
+  size_t k;
+
+  for (n = 0; n < this->signatures.size (); n++)
+    {
+      sig = &this->signatures[n];
+      node = 0;
+
+      for (k = sig->anchor; k < sig->anchor + sig->anchor_size; k++)
+        {
+          itr = children[node].find (sig->bytes[k]);
+          if (itr != children[node].end ())
+            {
+              node = itr->second;
+              continue;
+            }
+
+          child = children.size ();
+          children.push_back (std::map<uint8_t, uint32_t> ());
+          ends.push_back (std::vector<uint32_t> ());
+          children[node][sig->bytes[k]] = child;
+          node = child;
+        }
+
+      ends[node].push_back (n);
+    }
+
+  this->nodes.assign (children.size (), Node ());
+  this->edge_bytes.clear ();
+  this->edge_targets.clear ();
+  this->matches.clear ();
+
+  for (n = 0; n < children.size (); n++)
+    {
+      this->nodes[n].first_edge  = this->edge_bytes.size ();
+      this->nodes[n].edge_count  = children[n].size ();
+      this->nodes[n].first_match = this->matches.size ();
+      this->nodes[n].match_count = ends[n].size ();
+
+      for (itr = children[n].begin (); itr != children[n].end (); ++itr)
+        {
+          this->edge_bytes.push_back (itr->first);
+          this->edge_targets.push_back (itr->second);
+        }
+
+      this->matches.insert (this->matches.end (),
+                            ends[n].begin (), ends[n].end ());
+    }
+
+  for (n = 0; n < 256; n++)
+    {
+      child = this->find_edge (0, n);
+      this->root_next[n] = (child != NO_NODE ? child : 0);
+    }
+
+  /* Fail links of a node depend only on nodes closer to the root */
+  this->nodes[0].fail   = 0;
+  this->nodes[0].output = NO_NODE;
+  order.push_back (0);
+
+  for (n = 0; n < order.size (); n++)
+    {
+      node = order[n];
+
+      for (k = 0; k < this->nodes[node].edge_count; k++)
+        {
+          child = this->edge_targets[this->nodes[node].first_edge + k];
+
+          if (node == 0)
+            fail = 0;
+          else
+            fail = this->step (this->nodes[node].fail,
+                               this->edge_bytes[this->nodes[node].first_edge
+                                                + k]);
+
+          this->nodes[child].fail = fail;
+
+          if (this->nodes[fail].match_count > 0)
+            this->nodes[child].output = fail;
+          else
+            this->nodes[child].output = this->nodes[fail].output;
+
+          order.push_back (child);
+        }
+    }
+}
+
+uint32_t
+SignatureLibrary::find_edge (uint32_t node, uint8_t byte) const
+{
+  const uint8_t *first;
+  const uint8_t *last;
+  const uint8_t *itr;
+
+  first = this->edge_bytes.data () + this->nodes[node].first_edge;
+  last  = first + this->nodes[node].edge_count;
+  itr   = std::lower_bound (first, last, byte);
+
+  if (itr == last or *itr != byte)
+    return NO_NODE;
+
+  return this->edge_targets[itr - this->edge_bytes.data ()];
+}
+
+uint32_t
+SignatureLibrary::step (uint32_t node, uint8_t byte) const
+{
+  uint32_t next;
+
+  while (node != 0)
+    {
+      next = this->find_edge (node, byte);
+      if (next != NO_NODE)
+        return next;
+
+      node = this->nodes[node].fail;
+    }
+
+  return this->root_next[byte];
+}
+
+/** Checks whole signature at given offset within the object.
+ */
+bool
+SignatureLibrary::verify (const Signature *sig, const Image::Object *obj,
+                          uint32_t offset, const LEFM *fixups) const
+{
+  const Image::DataVector *data;
+  LEFM::const_iterator itr;
+  uint32_t end;
+  uint32_t n;
+
+  data = obj->get_data ();
+  end = offset + sig->bytes.size ();
+
+  if (end > data->size ())
+    return false;
+
+  for (n = 0; n < sig->bytes.size (); n++)
+    {
+      if (sig->mask[n] != 0 and (*data)[offset + n] != sig->bytes[n])
+        return false;
+    }
+
+  /* Relocated bytes hold other addresses in every executable */
+  itr = fixups->lower_bound (offset < fixup_size ? 0
+                                                 : offset - fixup_size + 1);
+
+  for (; itr != fixups->end () and itr->first < end; ++itr)
+    {
+      for (n = itr->first; n < itr->first + fixup_size; n++)
+        {
+          if (n >= offset and n < end and sig->mask[n - offset] != 0)
+            return false;
+        }
+    }
+
+  return true;
+}
+
+void
+SignatureLibrary::scan (const Image::Object *obj, const LEFM *fixups,
+                        std::vector<Match> *found) const
+{
+  const Image::DataVector *data;
+  const Signature *sig;
+  uint32_t node;
+  uint32_t out;
+  uint32_t start;
+  Match match;
+  size_t n;
+  size_t k;
+
+  data = obj->get_data ();
+  node = 0;
+
+  for (n = 0; n < data->size (); n++)
+    {
+      node = this->step (node, (*data)[n]);
+
+      out = (this->nodes[node].match_count > 0
+             ? node : this->nodes[node].output);
+
+      for (; out != NO_NODE; out = this->nodes[out].output)
+        {
+          for (k = 0; k < this->nodes[out].match_count; k++)
+            {
+              match.signature = this->matches[this->nodes[out].first_match
+                                              + k];
+              sig = &this->signatures[match.signature];
+
+              if (n + 1 < sig->anchor + sig->anchor_size)
+                continue;
+
+              start = n + 1 - sig->anchor_size - sig->anchor;
+              if (!this->verify (sig, obj, start, fixups))
+                continue;
+
+              match.address = obj->get_base_address () + start;
+              found->push_back (match);
+            }
+        }
+    }
+}
+
+void
+SignatureLibrary::load (const char *fname)
+{
+  std::ifstream ifs;
+  std::string line;
+  std::string pattern;
+  std::string name;
+  size_t line_no;
+  size_t skipped;
+
+  ifs.open (fname);
+  if (!ifs.is_open ())
+    throw Error () << "Error opening file: " << fname;
+
+  line_no = 0;
+  skipped = 0;
+
+  while (std::getline (ifs, line))
+    {
+      line_no++;
+
+      if (line.empty () or line[0] == '#')
+        continue;
+
+      std::istringstream iss (line);
+
+      if (!(iss >> pattern >> name))
+        throw Error () << fname << ":" << line_no << ": Invalid signature";
+
+      if (!this->add (pattern, name))
+        skipped++;
+    }
+
+  if (skipped > 0)
+    std::cerr << "Warning: Skipped " << skipped << " signatures without "
+              << min_anchor_size << " bytes in a row to match.\n";
+
+  this->build_automaton ();
+}
+
+size_t
+SignatureLibrary::size (void) const
+{
+  return this->signatures.size ();
+}
+
+/** Names functions matched in the executable objects.
+ *
+ * A name matched at several addresses, or an address matched by several
+ * names, is left alone, and so are names and addresses already labelled.
+ * Named functions are traced like any other function label.
+ */
+size_t
+SignatureLibrary::apply (Analyser *anal, const LinearExecutable *le,
+                         const Image *img) const
+{
+  std::vector<Match> found;
+  std::map<std::string, size_t> name_count;
+  std::map<uint32_t, size_t> address_count;
+  std::set<std::string> used_names;
+  const Analyser::LabelMap *labels;
+  const Image::Object *obj;
+  const Label *label;
+  const std::string *name;
+  size_t kept;
+  size_t named;
+  size_t ambiguous;
+  size_t n;
+
+  for (n = 0; n < img->get_object_count (); n++)
+    {
+      obj = img->get_object (n);
+      if (obj->is_executable ())
+        this->scan (obj, le->get_fixups_for_object (n), &found);
+    }
+
+  std::sort (found.begin (), found.end (),
+             [] (const Match &a, const Match &b)
+             {
+               if (a.address != b.address)
+                 return a.address < b.address;
+               return a.signature < b.signature;
+             });
+
+  /* Variants of one function share its name */
+  kept = 0;
+  for (n = 0; n < found.size (); n++)
+    {
+      if (kept > 0 and found[kept - 1].address == found[n].address
+          and (this->signatures[found[kept - 1].signature].name
+               == this->signatures[found[n].signature].name))
+        continue;
+
+      found[kept++] = found[n];
+    }
+  found.resize (kept);
+
+  for (n = 0; n < found.size (); n++)
+    {
+      name_count[this->signatures[found[n].signature].name]++;
+      address_count[found[n].address]++;
+    }
+
+  labels = anal->get_labels ();
+  for (n = 0; n < labels->size (); n++)
+    {
+      if (labels->get_sorted (n).has_name ())
+        used_names.insert (labels->get_sorted (n).get_name ());
+    }
+
+  named = 0;
+  ambiguous = 0;
+
+  for (n = 0; n < found.size (); n++)
+    {
+      name = &this->signatures[found[n].signature].name;
+
+      if (name_count[*name] > 1 or address_count[found[n].address] > 1)
+        {
+          ambiguous++;
+          continue;
+        }
+
+      label = anal->get_label (found[n].address);
+      if ((label != NULL and label->has_name ())
+          or used_names.count (*name) > 0)
+        continue;
+
+      anal->add_label (Label (found[n].address, Label::FUNCTION, *name));
+      named++;
+    }
+
+  std::cerr << "Signatures named " << named << " functions";
+  if (ambiguous > 0)
+    std::cerr << ", " << ambiguous << " ambiguous matches left out";
+  std::cerr << ".\n";
+
+  return named;
+}
+
+/** Writes signatures of the named functions of an analysed executable.
+ *
+ * Every signature covers the first bytes of a function, through its
+ * blocks laid out one after another from its entry. Relocated bytes and
+ * displacements of relative branches, which change with the layout of
+ * the executable, are masked. Patterns shared by functions with
+ * different names are left out.
+ */
+size_t
+SignatureLibrary::write (const char *fname, const Analyser *anal,
+                         const LinearExecutable *le, const Image *img,
+                         Disassembler *disasm)
+{
+  std::vector<std::pair<std::string, std::string> > entries;
+  std::map<std::string, std::set<std::string> > names;
+  std::string pattern;
+  std::ofstream ofs;
+  const ControlFlowGraph *cfg;
+  const ControlFlowGraph::Block *block;
+  const Image::Object *obj;
+  const LEFM *fixups;
+  LEFM::const_iterator itr;
+  const Label *lab;
+  SignatureLibrary check;
+  std::vector<uint8_t> mask;
+  uint32_t offset;
+  uint32_t addr;
+  uint32_t end;
+  uint32_t pos;
+  uint32_t target;
+  uint32_t field_offset;
+  uint32_t field_size;
+  size_t written;
+  size_t index;
+  size_t size;
+  size_t len;
+  size_t n;
+  size_t m;
+  char buffer[4];
+
+  cfg = anal->get_cfg ();
+
+  for (n = 0; n < cfg->get_function_count (); n++)
+    {
+      index = cfg->get_function_entry (n);
+      block = cfg->get_block (index);
+      addr  = block->start;
+      end   = block->end;
+
+      lab = anal->get_label (addr);
+      if (lab == NULL or !lab->has_name ())
+        continue;
+
+      for (m = index + 1; m < cfg->get_block_count ()
+                          and end - addr < max_signature_size; m++)
+        {
+          block = cfg->get_block (m);
+          if (block->start != end or block->function != n)
+            break;
+
+          end = block->end;
+        }
+
+      len = std::min<size_t> (end - addr, max_signature_size);
+      if (len < min_signature_size)
+        continue;
+
+      obj    = img->get_object_at_address (addr);
+      fixups = le->get_fixups_for_object (obj->get_index ());
+      offset = addr - obj->get_base_address ();
+
+      mask.assign (len, 1);
+
+      itr = fixups->lower_bound (offset < fixup_size
+                                 ? 0 : offset - fixup_size + 1);
+
+      for (; itr != fixups->end () and itr->first < offset + len; ++itr)
+        {
+          for (m = itr->first; m < itr->first + fixup_size; m++)
+            {
+              if (m >= offset and m < offset + len)
+                mask[m - offset] = 0;
+            }
+        }
+
+      for (pos = addr; pos < addr + len; pos += size)
+        {
+          size = disasm->find_branch_field (pos, obj->get_data_at (pos),
+                                            end - pos, &target,
+                                            &field_offset, &field_size);
+          size = std::max<size_t> (size, 1);
+
+          for (m = pos + field_offset;
+               m < pos + field_offset + field_size and m < addr + len; m++)
+            mask[m - addr] = 0;
+        }
+
+      pattern.clear ();
+
+      for (m = 0; m < len; m++)
+        {
+          if (mask[m] == 0)
+            pattern += "..";
+          else
+            {
+              snprintf (buffer, sizeof (buffer), "%02x",
+                        *obj->get_data_at (addr + m));
+              pattern += buffer;
+            }
+        }
+
+      if (!check.add (pattern, lab->get_name ()))
+        continue;
+
+      entries.push_back (std::make_pair (pattern, lab->get_name ()));
+      names[pattern].insert (lab->get_name ());
+    }
+
+  ofs.open (fname, std::ios::trunc);
+  if (!ofs.is_open ())
+    throw Error () << "Error creating file: " << fname;
+
+  ofs << "# le_disasm function signatures\n";
+  written = 0;
+
+  for (n = 0; n < entries.size (); n++)
+    {
+      if (names[entries[n].first].size () > 1)
+        continue;
+
+      ofs << entries[n].first << " " << entries[n].second << "\n";
+      written++;
+    }
+
+  if (!ofs)
+    throw Error () << "Error writing file: " << fname;
+
+  std::cerr << "Wrote " << written << " signatures to " << fname << ".\n";
+  return written;
+}
@@ -0,0 +1,102 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file signatures.hpp
+ *     Header file for signatures.cpp, with declaration of SignatureLibrary.
+ * @par Purpose:
+ *     Storage for SignatureLibrary class which names library functions,
+ *     like the Watcom C runtime, by matching their bytes.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#ifndef LEDISASM_SIGNATURES_H
+#define LEDISASM_SIGNATURES_H
+
+#include <inttypes.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "image.hpp"
+#include "le.hpp"
+
+class Analyser;
+class Disassembler;
+
+/** Byte patterns of known functions, matched in one pass over the code.
+ *
+ * Signature files have one function per line: its first bytes in hex,
+ * with ".." for bytes not compared, then its name. Lines starting with
+ * '#' are comments. Bytes changed by relocations are not compared,
+ * and a match is accepted only if every relocated byte at its place
+ * is masked. Written signatures also mask displacements of relative
+ * branches, so they match wherever the callees of a function lie.
+ *
+ * The longest run of compared bytes of every signature is put into
+ * an Aho-Corasick automaton, stored in flat arrays, and the rest of
+ * the signature is checked wherever the automaton finds its run.
+ */
+class SignatureLibrary
+{
+protected:
+  struct Signature
+  {
+    std::vector<uint8_t> bytes;
+    std::vector<uint8_t> mask;  /* non-zero for compared bytes */
+    std::string name;
+    uint32_t    anchor;         /* offset of the run in the automaton */
+    uint32_t    anchor_size;
+  };
+
+  struct Node
+  {
+    uint32_t fail;
+    uint32_t output;            /* nearest node on fail chain with matches */
+    uint32_t first_edge;
+    uint32_t edge_count;
+    uint32_t first_match;
+    uint32_t match_count;
+  };
+
+  struct Match
+  {
+    uint32_t address;
+    uint32_t signature;
+  };
+
+  std::vector<Signature> signatures;
+  std::vector<Node>      nodes;
+  std::vector<uint8_t>   edge_bytes;
+  std::vector<uint32_t>  edge_targets;
+  std::vector<uint32_t>  matches;
+  uint32_t               root_next[256];
+
+protected:
+  bool add (const std::string &pattern, const std::string &name);
+  void build_automaton (void);
+  uint32_t find_edge (uint32_t node, uint8_t byte) const;
+  uint32_t step (uint32_t node, uint8_t byte) const;
+  bool verify (const Signature *sig, const Image::Object *obj,
+               uint32_t offset, const LEFM *fixups) const;
+  void scan (const Image::Object *obj, const LEFM *fixups,
+             std::vector<Match> *found) const;
+
+public:
+  SignatureLibrary (void);
+
+  void   load (const char *fname);
+  size_t size (void) const;
+  size_t apply (Analyser *anal, const LinearExecutable *le,
+                const Image *img) const;
+
+  static size_t write (const char *fname, const Analyser *anal,
+                       const LinearExecutable *le, const Image *img,
+                       Disassembler *disasm);
+};
+
+#endif // LEDISASM_SIGNATURES_H
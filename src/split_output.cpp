@@ -0,0 +1,236 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file split_output.cpp
+ *     Implementation of SplitOutput class.
+ * @par Purpose:
+ *     Implements finding labels shared between parts of the listing,
+ *     and writing the parts with their declarations.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+#include "split_output.hpp"
+#include "output_sink.hpp"
+
+static inline bool
+is_symbol_char (char c)
+{
+  return ((c >= 'a' and c <= 'z') or (c >= 'A' and c <= 'Z')
+          or (c >= '0' and c <= '9') or c == '_' or c == '.');
+}
+
+static void
+sort_unique (std::vector<std::string> *names)
+{
+  std::sort (names->begin (), names->end ());
+  names->erase (std::unique (names->begin (), names->end ()), names->end ());
+}
+
+/** Lists symbols defined by a part, and all other words it uses.
+ *
+ * Comments and quoted strings are skipped, and so are numbers. Which of
+ * the words are labels is known only once definitions of all parts are
+ * collected.
+ */
+void
+SplitOutput::scan_symbols (const std::string &text,
+                           std::vector<std::string> *defined,
+                           std::vector<std::string> *used)
+{
+  const char *p;
+  const char *end;
+  const char *start;
+
+  p   = text.data ();
+  end = p + text.size ();
+
+  while (p < end)
+    {
+      if (*p == '/' and p + 1 < end and p[1] == '*')
+        {
+          start = strstr (p + 2, "*/");
+          p = (start == NULL ? end : start + 2);
+          continue;
+        }
+
+      if (*p == '"')
+        {
+          for (p++; p < end and *p != '"'; p++)
+            {
+              if (*p == '\\')
+                p++;
+            }
+
+          p++;
+          continue;
+        }
+
+      if (!is_symbol_char (*p))
+        {
+          p++;
+          continue;
+        }
+
+      start = p;
+      while (p < end and is_symbol_char (*p))
+        p++;
+
+      if (*start >= '0' and *start <= '9')
+        continue;
+
+      if (p < end and *p == ':')
+        defined->push_back (std::string (start, p - start));
+      else
+        used->push_back (std::string (start, p - start));
+    }
+
+  sort_unique (defined);
+  sort_unique (used);
+}
+
+void
+SplitOutput::resize (size_t count)
+{
+  this->parts.resize (count);
+}
+
+size_t
+SplitOutput::size (void) const
+{
+  return this->parts.size ();
+}
+
+std::string *
+SplitOutput::get_text (size_t index)
+{
+  return &this->parts[index].text;
+}
+
+/** Finds labels used by parts other than the one defining them.
+ */
+void
+SplitOutput::link (void)
+{
+  typedef std::unordered_map<std::string, size_t> OwnerMap;
+
+  std::vector<std::vector<std::string> > used (this->parts.size ());
+  std::vector<std::string> defined;
+  OwnerMap owners;
+  OwnerMap::const_iterator owner;
+  size_t n;
+  size_t k;
+
+  for (n = 0; n < this->parts.size (); n++)
+    {
+      defined.clear ();
+      scan_symbols (this->parts[n].text, &defined, &used[n]);
+
+      for (k = 0; k < defined.size (); k++)
+        owners.insert (OwnerMap::value_type (defined[k], n));
+
+      this->parts[n].globals.clear ();
+      this->parts[n].externs.clear ();
+    }
+
+  for (n = 0; n < this->parts.size (); n++)
+    {
+      for (k = 0; k < used[n].size (); k++)
+        {
+          owner = owners.find (used[n][k]);
+          if (owner == owners.end () or owner->second == n)
+            continue;
+
+          this->parts[n].externs.push_back (used[n][k]);
+          this->parts[owner->second].globals.push_back (used[n][k]);
+        }
+    }
+
+  for (n = 0; n < this->parts.size (); n++)
+    sort_unique (&this->parts[n].globals);
+}
+
+/** Returns name of the file of given part.
+ */
+std::string
+SplitOutput::get_part_name (const char *fname, size_t index)
+{
+  std::string name;
+  size_t dot;
+  size_t slash;
+  char number[16];
+
+  name  = fname;
+  dot   = name.rfind ('.');
+  slash = name.find_last_of ("/\\");
+
+  if (dot == std::string::npos
+      or (slash != std::string::npos and dot < slash))
+    dot = name.size ();
+
+  snprintf (number, sizeof (number), "_%03u", (unsigned int) index);
+  name.insert (dot, number);
+
+  return name;
+}
+
+/** Writes every part to its file, and the file including them all.
+ */
+void
+SplitOutput::write (const char *fname, const char *header) const
+{
+  std::string part_fname;
+  size_t slash;
+  size_t n;
+  size_t k;
+
+  OutputSink master (fname);
+
+  for (n = 0; n < this->parts.size (); n++)
+    {
+      part_fname = get_part_name (fname, n);
+
+      {
+        OutputSink out (part_fname.c_str ());
+
+        out.write (header);
+
+        for (k = 0; k < this->parts[n].globals.size (); k++)
+          {
+            out.write (".globl ");
+            out.write (this->parts[n].globals[k]);
+            out.put ('\n');
+          }
+
+        for (k = 0; k < this->parts[n].externs.size (); k++)
+          {
+            out.write (".extern ");
+            out.write (this->parts[n].externs[k]);
+            out.put ('\n');
+          }
+
+        out.write (this->parts[n].text);
+        out.flush ();
+      }
+
+      /* Parts are next to the master file, so it names them alone */
+      slash = part_fname.find_last_of ("/\\");
+      if (slash != std::string::npos)
+        part_fname.erase (0, slash + 1);
+
+      master.write (".include \"");
+      master.write (part_fname);
+      master.write ("\"\n");
+    }
+
+  master.flush ();
+}
@@ -0,0 +1,64 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file split_output.hpp
+ *     Header file for split_output.cpp, with declaration of SplitOutput.
+ * @par Purpose:
+ *     Storage for SplitOutput class which writes the listing as a number
+ *     of assembly files, which can be assembled separately.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#ifndef LEDISASM_SPLIT_OUTPUT_H
+#define LEDISASM_SPLIT_OUTPUT_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/** Listing split into parts, each written to a file of its own.
+ *
+ * Parts are rendered separately into their texts. Linking them finds
+ * labels referenced from a part other than the one defining them; these
+ * are declared with .globl where defined and with .extern where used.
+ *
+ * Part files are named after the output file, with a number added before
+ * its extension, and the output file itself includes them all in order.
+ * Assembling it gives the same result as the listing printed as a whole,
+ * while the parts can be assembled separately and linked in the same
+ * order.
+ */
+class SplitOutput
+{
+protected:
+  struct Part
+  {
+    std::string              text;
+    std::vector<std::string> globals;
+    std::vector<std::string> externs;
+  };
+
+  std::vector<Part> parts;
+
+protected:
+  static void scan_symbols (const std::string &text,
+                            std::vector<std::string> *defined,
+                            std::vector<std::string> *used);
+
+public:
+  void   resize (size_t count);
+  size_t size (void) const;
+  std::string *get_text (size_t index);
+
+  void link (void);
+  void write (const char *fname, const char *header) const;
+
+  static std::string get_part_name (const char *fname, size_t index);
+};
+
+#endif // LEDISASM_SPLIT_OUTPUT_H
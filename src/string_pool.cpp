@@ -0,0 +1,49 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file string_pool.cpp
+ *     Implementation of StringPool class.
+ * @par Purpose:
+ *     Implements interning of strings.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#include <cassert>
+
+#include "string_pool.hpp"
+
+StringPool::StringPool (void)
+{
+  this->intern ("");
+}
+
+uint32_t
+StringPool::intern (const std::string &str)
+{
+  std::pair<IndexMap::iterator, bool> ret;
+
+  ret = this->index.insert (std::make_pair (str, this->strings.size ()));
+  if (ret.second)
+    /* Keys of the map do not move, so they can be referenced directly */
+    this->strings.push_back (&ret.first->first);
+
+  return ret.first->second;
+}
+
+const std::string &
+StringPool::get (uint32_t id) const
+{
+  assert (id < this->strings.size ());
+  return *this->strings[id];
+}
+
+size_t
+StringPool::size (void) const
+{
+  return this->strings.size ();
+}
@@ -0,0 +1,46 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file string_pool.hpp
+ *     Header file for string_pool.cpp, with declaration of StringPool class.
+ * @par Purpose:
+ *     Storage for StringPool class which keeps a single copy of every
+ *     distinct string, referenced by a small numeric identifier.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#ifndef LEDISASM_STRING_POOL_H
+#define LEDISASM_STRING_POOL_H
+
+#include <inttypes.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/** Pool of interned strings.
+ *
+ * Identifier 0 always stands for the empty string. Strings are never
+ * removed, so references returned by get() stay valid.
+ */
+class StringPool
+{
+protected:
+  typedef std::unordered_map<std::string, uint32_t> IndexMap;
+
+  IndexMap                         index;
+  std::vector<const std::string *> strings;
+
+public:
+  StringPool (void);
+
+  uint32_t intern (const std::string &str);
+  const std::string &get (uint32_t id) const;
+  size_t size (void) const;
+};
+
+#endif // LEDISASM_STRING_POOL_H
@@ -0,0 +1,290 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file symbol_index.cpp
+ *     Implementation of SymbolIndex class.
+ * @par Purpose:
+ *     Implements building of the address lookup and replacing of
+ *     addresses within instruction text in a single pass.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#include <cstring>
+
+#include "symbol_index.hpp"
+#include "analyser.hpp"
+
+/* Slot value of an unused hash slot */
+static const uint32_t empty_slot = 0xffffffff;
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static inline size_t
+hash_address (uint32_t address)
+{
+  return (address * 0x9e3779b1u) >> 7;
+}
+
+/* Returns value of hex digit, or -1 if the character is not one. */
+static inline int
+hex_digit_value (char c)
+{
+  if (c >= '0' and c <= '9')
+    return c - '0';
+  if (c >= 'a' and c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' and c <= 'F')
+    return c - 'A' + 10;
+
+  return -1;
+}
+
+/* Words printed before the mnemonic of an instruction */
+static const char *const prefix_words[] = {
+  "cs", "ds", "es", "ss", "fs", "gs", "data16", "addr16", "lock",
+  "rep", "repz", "repnz", "repe", "repne", "bnd", "notrack", NULL
+};
+
+static inline bool
+is_word_char (char c)
+{
+  return ((c >= 'a' and c <= 'z') or (c >= '0' and c <= '9'));
+}
+
+/* Returns true if the instruction text is of a branch, whose operand is
+ * an address even if not in brackets. */
+static bool
+is_branch_text (const char *str, size_t len)
+{
+  size_t start;
+  size_t n;
+  size_t k;
+
+  n = 0;
+
+  while (n < len)
+    {
+      start = n;
+      while (n < len and is_word_char (str[n]))
+        n++;
+
+      if (n > start and str[start] == 'j')
+        return true;
+
+      if ((n - start == 4 and strncmp (str + start, "call", 4) == 0)
+          or (n - start >= 4 and strncmp (str + start, "loop", 4) == 0))
+        return true;
+
+      for (k = 0; prefix_words[k] != NULL; k++)
+        {
+          if (strlen (prefix_words[k]) == n - start
+              and strncmp (str + start, prefix_words[k], n - start) == 0)
+            break;
+        }
+
+      if (prefix_words[k] == NULL)
+        return false;
+
+      while (n < len and str[n] == ' ')
+        n++;
+    }
+
+  return false;
+}
+
+/* Returns slot holding given address, or the free slot it would go to. */
+size_t
+SymbolIndex::find_slot (uint32_t address) const
+{
+  size_t mask;
+  size_t n;
+
+  mask = this->slots.size () - 1;
+  n = hash_address (address) & mask;
+
+  while (this->slots[n] != empty_slot
+         and this->entries[this->slots[n]].address != address)
+    n = (n + 1) & mask;
+
+  return n;
+}
+
+void
+SymbolIndex::insert (const Entry &entry)
+{
+  this->slots[this->find_slot (entry.address)] = this->entries.size ();
+  this->entries.push_back (entry);
+}
+
+const SymbolIndex::Entry *
+SymbolIndex::find (uint32_t address) const
+{
+  size_t n;
+
+  n = this->find_slot (address);
+  if (this->slots[n] == empty_slot)
+    return NULL;
+
+  return &this->entries[this->slots[n]];
+}
+
+/** Indexes labels of the analysis, and relocated addresses without one.
+ */
+void
+SymbolIndex::build (const Analyser *anal, const LinearExecutable *le,
+                    const Image *img, AsmSyntax syntax)
+{
+  const LinearExecutable::AddressSet *fixups;
+  LinearExecutable::AddressSet::const_iterator itr;
+  const Analyser::LabelMap *labels;
+  const Label *lab;
+  Entry entry;
+  size_t capacity;
+  size_t n;
+  int shift;
+
+  labels = anal->get_labels ();
+  fixups = le->get_fixup_addresses ();
+
+  this->syntax = syntax;
+
+  capacity = 64;
+  while (capacity < 2 * (labels->size () + fixups->size ()))
+    capacity *= 2;
+
+  this->entries.clear ();
+  this->entries.reserve (labels->size ());
+  this->slots.assign (capacity, empty_slot);
+  this->text.clear ();
+
+  for (n = 0; n < labels->size (); n++)
+    {
+      lab = &labels->get_sorted (n);
+
+      entry.address     = lab->get_address ();
+      entry.text_offset = this->text.size ();
+
+      if (lab->has_name ())
+        this->text.append (lab->get_name ());
+      else
+        {
+          this->text.append (lab->get_prefix ());
+          this->text.push_back ('_');
+
+          /* Hex digits without base and leading zeros */
+          for (shift = 28; shift > 0; shift -= 4)
+            {
+              if ((entry.address >> shift) != 0)
+                break;
+            }
+          for (; shift >= 0; shift -= 4)
+            this->text.push_back (hex_digits[(entry.address >> shift) & 0xf]);
+        }
+
+      entry.text_size = this->text.size () - entry.text_offset;
+      this->insert (entry);
+    }
+
+  for (itr = fixups->begin (); itr != fixups->end (); ++itr)
+    {
+      if (img->get_object_at_address (*itr) == NULL
+          or this->find (*itr) != NULL)
+        continue;
+
+      entry.address     = *itr;
+      entry.text_offset = 0;
+      entry.text_size   = 0;
+      this->insert (entry);
+    }
+}
+
+/** Appends text with every "0x" hex number replaced by its label.
+ *
+ * Numbers without a label are copied unchanged. Returns true if any of
+ * them is a relocated address within an object, which should have had
+ * a label.
+ *
+ * In Intel syntax a number in instruction text is an immediate unless
+ * it is in brackets, follows a segment, or is an operand of a branch.
+ */
+bool
+SymbolIndex::symbolise (const char *str, size_t len, std::string *out,
+                        Usage usage) const
+{
+  const Entry *entry;
+  size_t start;
+  size_t digits;
+  size_t n;
+  uint32_t addr;
+  bool warning;
+  bool branch;
+  bool immediate;
+  int depth;
+  int value;
+
+  warning = false;
+  start = 0;
+  depth = 0;
+  n = 0;
+
+  branch = (this->syntax == SYNTAX_INTEL and usage == TEXT
+            and is_branch_text (str, len));
+
+  while (n + 2 < len)
+    {
+      if (str[n] != '0' or str[n + 1] != 'x')
+        {
+          if (str[n] == '[')
+            depth++;
+          else if (str[n] == ']')
+            depth--;
+
+          n++;
+          continue;
+        }
+
+      out->append (str + start, n - start);
+
+      if (usage == TEXT)
+        immediate = (!branch and depth == 0
+                     and (n == 0 or str[n - 1] != ':'));
+      else
+        immediate = (usage == IMMEDIATE);
+
+      n += 2;
+      digits = n;
+      addr = 0;
+
+      while (n < len and (value = hex_digit_value (str[n])) >= 0)
+        {
+          addr = (addr << 4) | value;
+          n++;
+        }
+
+      entry = this->find (addr);
+      if (entry != NULL and entry->text_size != 0)
+        {
+          if (immediate and this->syntax == SYNTAX_INTEL)
+            out->append ("offset ", 7);
+
+          out->append (this->text, entry->text_offset, entry->text_size);
+        }
+      else
+        {
+          out->append (str + digits - 2, n - digits + 2);
+
+          if (entry != NULL)
+            warning = true;
+        }
+
+      start = n;
+    }
+
+  out->append (str + start, len - start);
+  return warning;
+}
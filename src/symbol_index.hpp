@@ -0,0 +1,85 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file symbol_index.hpp
+ *     Header file for symbol_index.cpp, with declaration of SymbolIndex.
+ * @par Purpose:
+ *     Storage for SymbolIndex class which replaces addresses within
+ *     instruction text with names of their labels.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#ifndef LEDISASM_SYMBOL_INDEX_H
+#define LEDISASM_SYMBOL_INDEX_H
+
+#include <inttypes.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "formatter.hpp"
+#include "image.hpp"
+#include "le.hpp"
+
+class Analyser;
+
+/** Read-only lookup of the text printed in place of an address.
+ *
+ * Built once the analysis is final, it maps every labelled address to
+ * the label text, rendered in advance into one buffer, and marks
+ * relocated addresses within objects which have no label. Entries are
+ * kept in an open addressing hash table, so a lookup is a few compares,
+ * and the index may be read from many threads at once.
+ *
+ * In Intel syntax a bare label is read as a memory operand, so labels
+ * of immediate operands are written with "offset" before them.
+ */
+class SymbolIndex
+{
+public:
+  /** How numbers in the symbolised text are used.
+   */
+  enum Usage
+  {
+    TEXT,       /* instruction text; usage of each number found from it */
+    ADDRESS,    /* lone branch target or memory displacement */
+    IMMEDIATE   /* lone immediate operand */
+  };
+
+protected:
+  struct Entry
+  {
+    uint32_t address;
+    uint32_t text_offset;
+    uint32_t text_size;         /* zero for relocated address without label */
+  };
+
+  std::vector<Entry>    entries;
+  std::vector<uint32_t> slots;
+  std::string           text;
+  AsmSyntax             syntax;
+
+protected:
+  size_t find_slot (uint32_t address) const;
+  void   insert (const Entry &entry);
+  const Entry *find (uint32_t address) const;
+
+public:
+  void build (const Analyser *anal, const LinearExecutable *le,
+              const Image *img, AsmSyntax syntax);
+
+  bool symbolise (const char *str, size_t len, std::string *out,
+                  Usage usage = TEXT) const;
+  bool symbolise (const std::string &str, std::string *out,
+                  Usage usage = TEXT) const
+  {
+    return this->symbolise (str.data (), str.size (), out, usage);
+  }
+};
+
+#endif // LEDISASM_SYMBOL_INDEX_H
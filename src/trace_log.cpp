@@ -0,0 +1,407 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file trace_log.cpp
+ *     Implementation of TraceLog class.
+ * @par Purpose:
+ *     Implements recording of traced blocks and finding the ones which
+ *     have to be traced again after an edit.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#include <algorithm>
+#include <cassert>
+
+#include "trace_log.hpp"
+
+TraceLog::TraceLog (void)
+{
+  this->in_block = false;
+}
+
+void
+TraceLog::clear (void)
+{
+  this->blocks.clear ();
+  this->edges.clear ();
+  this->roots.clear ();
+  this->dirty.clear ();
+  this->removed.clear ();
+  this->in_block = false;
+}
+
+void
+TraceLog::begin_block (uint32_t start)
+{
+  Block block;
+
+  assert (!this->in_block);
+
+  block.start      = start;
+  block.end        = start;
+  block.first_edge = this->edges.size ();
+  block.edge_count = 0;
+
+  this->blocks.push_back (block);
+  this->in_block = true;
+}
+
+void
+TraceLog::extend_block (uint32_t end)
+{
+  assert (this->in_block);
+  this->blocks.back ().end = std::max (this->blocks.back ().end, end);
+}
+
+void
+TraceLog::end_block (void)
+{
+  this->in_block = false;
+}
+
+/* Records queued address, as an edge when inside a block. */
+void
+TraceLog::add_target (uint32_t addr)
+{
+  if (this->in_block)
+    {
+      this->edges.push_back (addr);
+      this->blocks.back ().edge_count++;
+    }
+  else
+    this->add_root (addr, 0, 0);
+}
+
+/* Records root found by analysis of the given bytes. */
+void
+TraceLog::add_root (uint32_t addr, uint32_t source_start, uint32_t source_end)
+{
+  Root root;
+
+  root.target       = addr;
+  root.source.start = source_start;
+  root.source.end   = source_end;
+  this->roots.push_back (root);
+}
+
+/* Drops address from roots; blocks leading to it are traced again. */
+void
+TraceLog::remove_root (uint32_t addr)
+{
+  this->roots.erase (std::remove_if (this->roots.begin (), this->roots.end (),
+                                     [addr] (const Root &root)
+                                     {
+                                       return root.target == addr;
+                                     }),
+                     this->roots.end ());
+  this->removed.push_back (addr);
+}
+
+void
+TraceLog::invalidate (uint32_t start, uint32_t end)
+{
+  Range range;
+
+  /* Nothing traced yet, nothing to invalidate */
+  if (this->blocks.empty ())
+    return;
+
+  range.start = start;
+  range.end   = end;
+  this->dirty.push_back (range);
+}
+
+bool
+TraceLog::needs_sweep (void) const
+{
+  return (!this->removed.empty () or !this->dirty.empty ());
+}
+
+/* Ranges have to be sorted and disjoint, as left by merge_ranges (). */
+bool
+TraceLog::overlaps (const std::vector<Range> &ranges, uint32_t start,
+                    uint32_t end)
+{
+  std::vector<Range>::const_iterator itr;
+
+  if (start >= end)
+    return false;
+
+  itr = std::lower_bound (ranges.begin (), ranges.end (), end,
+                          [] (const Range &range, uint32_t addr)
+                          {
+                            return range.start < addr;
+                          });
+  return (itr != ranges.begin () and (itr - 1)->end > start);
+}
+
+/** Checks whether block has to be traced again.
+ *
+ * Removed roots have to be sorted before.
+ */
+bool
+TraceLog::is_dirty (const Block *block) const
+{
+  size_t e;
+
+  /* Tracing stopped at start of a dirty range might now go on */
+  if (overlaps (this->dirty, block->start, block->end + 1))
+    return true;
+
+  /* Tracing it again restores labels of targets still leading there */
+  for (e = 0; e < block->edge_count; e++)
+    {
+      if (std::binary_search (this->removed.begin (), this->removed.end (),
+                              this->edges[block->first_edge + e]))
+        return true;
+    }
+
+  return false;
+}
+
+void
+TraceLog::merge_ranges (std::vector<Range> *ranges)
+{
+  size_t kept;
+  size_t n;
+
+  std::sort (ranges->begin (), ranges->end (),
+             [] (const Range &a, const Range &b)
+             {
+               return a.start < b.start;
+             });
+
+  kept = 0;
+
+  for (n = 0; n < ranges->size (); n++)
+    {
+      if (kept > 0 and (*ranges)[n].start <= (*ranges)[kept - 1].end)
+        (*ranges)[kept - 1].end = std::max ((*ranges)[kept - 1].end,
+                                            (*ranges)[n].end);
+      else
+        (*ranges)[kept++] = (*ranges)[n];
+    }
+
+  ranges->resize (kept);
+}
+
+/** Marks blocks reachable from roots not derived from dirty bytes.
+ *
+ * Block indices have to be given sorted by block start. Returns sorted
+ * targets of the roots and of the reached blocks.
+ */
+void
+TraceLog::reach (const std::vector<uint32_t> &order,
+                 std::vector<uint8_t> *reached,
+                 std::vector<uint32_t> *wanted) const
+{
+  std::vector<uint32_t>::const_iterator itr;
+  std::vector<uint32_t> stack;
+  const Block *block;
+  uint32_t addr;
+  size_t index;
+  size_t n;
+  size_t e;
+
+  reached->assign (this->blocks.size (), 0);
+  wanted->clear ();
+
+  for (n = 0; n < this->roots.size (); n++)
+    {
+      if (!overlaps (this->dirty, this->roots[n].source.start,
+                     this->roots[n].source.end))
+        stack.push_back (this->roots[n].target);
+    }
+
+  *wanted = stack;
+
+  while (!stack.empty ())
+    {
+      addr = stack.back ();
+      stack.pop_back ();
+
+      itr = std::lower_bound (order.begin (), order.end (), addr,
+                              [this] (uint32_t index, uint32_t addr)
+                              {
+                                return this->blocks[index].start < addr;
+                              });
+      if (itr == order.end () or this->blocks[*itr].start != addr)
+        continue;
+
+      index = *itr;
+      block = &this->blocks[index];
+      if ((*reached)[index] or this->is_dirty (block))
+        continue;
+
+      (*reached)[index] = 1;
+
+      for (e = 0; e < block->edge_count; e++)
+        {
+          wanted->push_back (this->edges[block->first_edge + e]);
+          stack.push_back (this->edges[block->first_edge + e]);
+        }
+    }
+
+  std::sort (wanted->begin (), wanted->end ());
+  wanted->erase (std::unique (wanted->begin (), wanted->end ()),
+                 wanted->end ());
+}
+
+/** Drops blocks affected by edits since the last sweep.
+ *
+ * Returns merged ranges of dropped blocks and dirty ranges, which have
+ * to be cleared by the caller, and sorted addresses which are still
+ * queued by roots or by kept blocks; the ones within cleared ranges
+ * have to be traced again. Sorted addresses which only dropped blocks
+ * led to are returned as orphans.
+ */
+void
+TraceLog::sweep (std::vector<Range> *cleared, std::vector<uint32_t> *wanted,
+                 std::vector<uint32_t> *orphans)
+{
+  std::vector<uint32_t> order;
+  std::vector<uint8_t> reached;
+  std::vector<Range> dropped;
+  std::vector<Block> kept_blocks;
+  std::vector<uint32_t> kept_edges;
+  const Block *block;
+  const Root *root;
+  Block copy;
+  Range range;
+  size_t kept;
+  size_t n;
+  size_t e;
+  bool grown;
+
+  assert (!this->in_block);
+
+  std::sort (this->removed.begin (), this->removed.end ());
+
+  order.resize (this->blocks.size ());
+  for (n = 0; n < order.size (); n++)
+    order[n] = n;
+
+  std::sort (order.begin (), order.end (),
+             [this] (uint32_t a, uint32_t b)
+             {
+               return this->blocks[a].start < this->blocks[b].start;
+             });
+
+  /* Roots derived from bytes next to dropped code, like vtables cut
+     short by it, have to be found again as well */
+  do
+    {
+      merge_ranges (&this->dirty);
+      this->reach (order, &reached, wanted);
+
+      dropped.clear ();
+
+      for (n = 0; n < this->blocks.size (); n++)
+        {
+          block = &this->blocks[n];
+
+          if (!reached[n] and block->end > block->start)
+            {
+              range.start = block->start;
+              range.end   = block->end;
+              dropped.push_back (range);
+            }
+        }
+
+      merge_ranges (&dropped);
+      grown = false;
+
+      for (n = 0; n < this->roots.size (); n++)
+        {
+          root = &this->roots[n];
+
+          if (root->source.start < root->source.end
+              and !overlaps (this->dirty, root->source.start,
+                             root->source.end)
+              and overlaps (dropped, root->source.start,
+                            root->source.end + 1))
+            {
+              this->dirty.push_back (root->source);
+              grown = true;
+            }
+        }
+    }
+  while (grown);
+
+  *cleared = this->dirty;
+  cleared->insert (cleared->end (), dropped.begin (), dropped.end ());
+  merge_ranges (cleared);
+
+  kept = 0;
+
+  for (n = 0; n < this->roots.size (); n++)
+    {
+      root = &this->roots[n];
+
+      if (!overlaps (this->dirty, root->source.start, root->source.end))
+        this->roots[kept++] = *root;
+    }
+
+  this->roots.resize (kept);
+
+  std::sort (this->roots.begin (), this->roots.end (),
+             [] (const Root &a, const Root &b)
+             {
+               if (a.target != b.target)
+                 return a.target < b.target;
+               if (a.source.start != b.source.start)
+                 return a.source.start < b.source.start;
+               return a.source.end < b.source.end;
+             });
+  this->roots.erase (std::unique (this->roots.begin (), this->roots.end (),
+                                  [] (const Root &a, const Root &b)
+                                  {
+                                    return (a.target == b.target
+                                            and a.source.start
+                                                == b.source.start
+                                            and a.source.end
+                                                == b.source.end);
+                                  }),
+                     this->roots.end ());
+
+  /* Keep reached blocks in their original order */
+  orphans->clear ();
+
+  for (n = 0; n < this->blocks.size (); n++)
+    {
+      block = &this->blocks[n];
+
+      if (!reached[n])
+        {
+          for (e = 0; e < block->edge_count; e++)
+            {
+              if (!std::binary_search (wanted->begin (), wanted->end (),
+                                       this->edges[block->first_edge + e]))
+                orphans->push_back (this->edges[block->first_edge + e]);
+            }
+          continue;
+        }
+
+      copy = *block;
+      copy.first_edge = kept_edges.size ();
+      kept_edges.insert (kept_edges.end (),
+                         this->edges.begin () + block->first_edge,
+                         this->edges.begin () + block->first_edge
+                         + block->edge_count);
+      kept_blocks.push_back (copy);
+    }
+
+  std::sort (orphans->begin (), orphans->end ());
+  orphans->erase (std::unique (orphans->begin (), orphans->end ()),
+                  orphans->end ());
+
+  this->blocks.swap (kept_blocks);
+  this->edges.swap (kept_edges);
+  this->dirty.clear ();
+  this->removed.clear ();
+}
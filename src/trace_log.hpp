@@ -0,0 +1,95 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file trace_log.hpp
+ *     Header file for trace_log.cpp, with declaration of TraceLog class.
+ * @par Purpose:
+ *     Storage for TraceLog class which records how traced code was found,
+ *     so that code depending on an edit can be found and traced again.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#ifndef LEDISASM_TRACE_LOG_H
+#define LEDISASM_TRACE_LOG_H
+
+#include <inttypes.h>
+#include <cstddef>
+#include <vector>
+
+/** Record of traced blocks and of the addresses they led to.
+ *
+ * Every successful start of tracing makes a block, covering the bytes
+ * traced from there on, with the targets queued by its instructions as
+ * edges. Targets queued from outside of any block, like the entry point,
+ * labels, vtable entries and guesses, are roots; the ones which were
+ * found by analysis keep range of bytes they were derived from.
+ *
+ * Edits mark address ranges dirty; a sweep then drops all blocks which
+ * overlap them, or end right at their start, or lead to a removed root,
+ * and all roots derived from them, together with all blocks no longer
+ * reachable from the remaining roots.
+ */
+class TraceLog
+{
+public:
+  struct Range
+  {
+    uint32_t start;
+    uint32_t end;
+  };
+
+protected:
+  struct Block
+  {
+    uint32_t start;
+    uint32_t end;
+    uint32_t first_edge;
+    uint32_t edge_count;
+  };
+
+  struct Root
+  {
+    uint32_t target;
+    Range    source;  /* empty when given by user */
+  };
+
+  std::vector<Block>    blocks;
+  std::vector<uint32_t> edges;
+  std::vector<Root>     roots;
+  std::vector<Range>    dirty;
+  std::vector<uint32_t> removed;
+  bool                  in_block;
+
+protected:
+  static bool overlaps (const std::vector<Range> &ranges, uint32_t start,
+                        uint32_t end);
+  static void merge_ranges (std::vector<Range> *ranges);
+  bool is_dirty (const Block *block) const;
+  void reach (const std::vector<uint32_t> &order,
+              std::vector<uint8_t> *reached,
+              std::vector<uint32_t> *wanted) const;
+
+public:
+  TraceLog (void);
+
+  void clear (void);
+
+  void begin_block (uint32_t start);
+  void extend_block (uint32_t end);
+  void end_block (void);
+  void add_target (uint32_t addr);
+  void add_root (uint32_t addr, uint32_t source_start, uint32_t source_end);
+
+  void remove_root (uint32_t addr);
+  void invalidate (uint32_t start, uint32_t end);
+  bool needs_sweep (void) const;
+  void sweep (std::vector<Range> *cleared, std::vector<uint32_t> *wanted,
+              std::vector<uint32_t> *orphans);
+};
+
+#endif // LEDISASM_TRACE_LOG_H
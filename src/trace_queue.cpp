@@ -0,0 +1,119 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file trace_queue.cpp
+ *     Implementation of TraceQueue class.
+ * @par Purpose:
+ *     Implements FIFO and address ordered work list of code addresses.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#include <algorithm>
+#include <functional>
+
+#include "trace_queue.hpp"
+
+TraceQueue::TraceQueue (Order order)
+{
+  this->order = order;
+}
+
+void
+TraceQueue::set_order (Order order)
+{
+  Data *data;
+
+  if (order == this->order)
+    return;
+
+  data = this->data.edit ();
+
+  /* Move pending addresses over to the other container */
+  if (order == ADDRESS)
+    {
+      data->heap.insert (data->heap.end (),
+                         data->fifo.begin (), data->fifo.end ());
+      data->fifo.clear ();
+      std::make_heap (data->heap.begin (), data->heap.end (),
+                      std::greater<uint32_t> ());
+    }
+  else
+    {
+      std::sort (data->heap.begin (), data->heap.end ());
+      data->fifo.insert (data->fifo.end (),
+                         data->heap.begin (), data->heap.end ());
+      data->heap.clear ();
+    }
+
+  this->order = order;
+}
+
+TraceQueue::Order
+TraceQueue::get_order (void) const
+{
+  return this->order;
+}
+
+bool
+TraceQueue::empty (void) const
+{
+  return (this->data->fifo.empty () and this->data->heap.empty ());
+}
+
+size_t
+TraceQueue::size (void) const
+{
+  return this->data->fifo.size () + this->data->heap.size ();
+}
+
+void
+TraceQueue::push (uint32_t addr)
+{
+  Data *data;
+
+  data = this->data.edit ();
+
+  if (this->order == FIFO)
+    data->fifo.push_back (addr);
+  else
+    {
+      data->heap.push_back (addr);
+      std::push_heap (data->heap.begin (), data->heap.end (),
+                      std::greater<uint32_t> ());
+    }
+}
+
+uint32_t
+TraceQueue::pop (void)
+{
+  Data *data;
+  uint32_t addr;
+
+  data = this->data.edit ();
+
+  if (this->order == FIFO)
+    {
+      addr = data->fifo.front ();
+      data->fifo.pop_front ();
+    }
+  else
+    {
+      std::pop_heap (data->heap.begin (), data->heap.end (),
+                     std::greater<uint32_t> ());
+      addr = data->heap.back ();
+      data->heap.pop_back ();
+    }
+
+  return addr;
+}
+
+void
+TraceQueue::clear (void)
+{
+  this->data = CowPtr<Data> ();
+}
@@ -0,0 +1,73 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file trace_queue.hpp
+ *     Header file for trace_queue.cpp, with declaration of TraceQueue class.
+ * @par Purpose:
+ *     Storage for TraceQueue class which holds addresses waiting to be
+ *     traced, and decides the order in which they are traced.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#ifndef LEDISASM_TRACE_QUEUE_H
+#define LEDISASM_TRACE_QUEUE_H
+
+#include <inttypes.h>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+#include "cow_ptr.hpp"
+
+/** Work list of code addresses to trace.
+ *
+ * In FIFO order, addresses are traced in the order they were found.
+ * In ADDRESS order, the lowest pending address is always traced first,
+ * so tracing walks the memory mostly sequentially.
+ *
+ * The order matters where code paths overlap: the path traced first
+ * keeps the bytes, and a misaligned one reaching them later is dropped.
+ * Executables with such code may be listed differently in each order.
+ *
+ * The queue does not filter duplicates; Analyser drops addresses which
+ * are already queued or traced before pushing them. Copies of the queue
+ * share pending addresses until one of them is modified.
+ */
+class TraceQueue
+{
+public:
+  enum Order
+  {
+    FIFO,
+    ADDRESS
+  };
+
+protected:
+  struct Data
+  {
+    std::deque<uint32_t>  fifo;
+    std::vector<uint32_t> heap;
+  };
+
+  Order        order;
+  CowPtr<Data> data;
+
+public:
+  TraceQueue (Order order = FIFO);
+
+  void  set_order (Order order);
+  Order get_order (void) const;
+
+  bool     empty (void) const;
+  size_t   size (void) const;
+  void     push (uint32_t addr);
+  uint32_t pop (void);
+  void     clear (void);
+};
+
+#endif // LEDISASM_TRACE_QUEUE_H
@@ -156,6 +156,27 @@ read_s8 (const void *memory)
   return *(int8_t *) memory;
 }
 
+static const uint64_t fnv1a_offset_basis = 0xcbf29ce484222325ULL;
+
+/** Continues 64-bit FNV-1a hash of a byte stream. */
+static inline uint64_t
+fnv1a_hash (const void *memory, size_t len,
+            uint64_t hash = fnv1a_offset_basis)
+{
+  const uint8_t *p;
+  size_t n;
+
+  p = (const uint8_t *) memory;
+
+  for (n = 0; n < len; n++)
+    {
+      hash ^= p[n];
+      hash *= 0x100000001b3ULL;
+    }
+
+  return hash;
+}
+
 template <typename T>
 void
 print_variable (std::ostream *os, size_t value_column,
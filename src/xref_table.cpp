@@ -0,0 +1,246 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file xref_table.cpp
+ *     Implementation of XrefTable class.
+ * @par Purpose:
+ *     Implements collecting of references from tracing and relocations,
+ *     and their lookup by source or target address.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#include <algorithm>
+
+#include "xref_table.hpp"
+#include "database.hpp"
+#include "le.hpp"
+#include "shadow_map.hpp"
+
+/* Longest x86 instruction */
+static const uint32_t max_instruction_size = 15;
+
+static bool
+source_less (const XrefTable::Xref &a, const XrefTable::Xref &b)
+{
+  if (a.source != b.source)
+    return a.source < b.source;
+  if (a.target != b.target)
+    return a.target < b.target;
+  return a.kind < b.kind;
+}
+
+static bool
+target_less (const XrefTable::Xref &a, const XrefTable::Xref &b)
+{
+  if (a.target != b.target)
+    return a.target < b.target;
+  if (a.source != b.source)
+    return a.source < b.source;
+  return a.kind < b.kind;
+}
+
+static bool
+same_xref (const XrefTable::Xref &a, const XrefTable::Xref &b)
+{
+  return (a.source == b.source and a.target == b.target
+          and a.kind == b.kind);
+}
+
+void
+XrefTable::clear (void)
+{
+  this->code_refs.clear ();
+  this->by_source.clear ();
+  this->by_target.clear ();
+}
+
+/* Records target of a traced call or jump. */
+void
+XrefTable::add_code_ref (uint32_t source, uint32_t target, Kind kind)
+{
+  Xref xref;
+
+  xref.source = source;
+  xref.target = target;
+  xref.kind   = kind;
+  this->code_refs.push_back (xref);
+}
+
+/* Sorts code references, dropping the ones no longer traced at source. */
+void
+XrefTable::compact_code_refs (const ShadowMap *shadow)
+{
+  size_t kept;
+  size_t n;
+
+  std::stable_sort (this->code_refs.begin (), this->code_refs.end (),
+                    [] (const Xref &a, const Xref &b)
+                    {
+                      return a.source < b.source;
+                    });
+
+  kept = 0;
+
+  for (n = 0; n < this->code_refs.size (); n++)
+    {
+      if (!shadow->is_instruction_start (this->code_refs[n].source))
+        continue;
+
+      /* Code traced again after an update records its targets again */
+      if (kept > 0
+          and this->code_refs[kept - 1].source == this->code_refs[n].source)
+        kept--;
+
+      this->code_refs[kept++] = this->code_refs[n];
+    }
+
+  this->code_refs.resize (kept);
+}
+
+/* Returns start of instruction containing addr, or addr outside of code. */
+uint32_t
+XrefTable::find_instruction (const ShadowMap *shadow, uint32_t addr)
+{
+  uint32_t start;
+  uint8_t flags;
+
+  for (start = addr; addr - start < max_instruction_size; start--)
+    {
+      flags = shadow->get_flags (start);
+
+      if ((flags & ShadowMap::CODE_START) != 0)
+        return start;
+      if ((flags & ShadowMap::CODE) == 0)
+        break;
+    }
+
+  return addr;
+}
+
+/** Builds the index for given state of analysis.
+ *
+ * Code references recorded so far are kept, so the index can be built
+ * again after further tracing.
+ */
+void
+XrefTable::build (const LinearExecutable *le, const ShadowMap *shadow)
+{
+  const LEOH *ohdr;
+  const LEFM *fixups;
+  LEFM::const_iterator itr;
+  Xref xref;
+  size_t n;
+
+  this->compact_code_refs (shadow);
+  this->by_source = this->code_refs;
+
+  for (n = 0; n < le->get_object_count (); n++)
+    {
+      ohdr   = le->get_object_header (n);
+      fixups = le->get_fixups_for_object (n);
+
+      for (itr = fixups->begin (); itr != fixups->end (); ++itr)
+        {
+          xref.source = find_instruction (shadow,
+                                          ohdr->base_address + itr->first);
+          xref.target = itr->second.address;
+          xref.kind   = POINTER;
+          this->by_source.push_back (xref);
+        }
+    }
+
+  std::sort (this->by_source.begin (), this->by_source.end (), source_less);
+  this->by_source.erase (std::unique (this->by_source.begin (),
+                                      this->by_source.end (), same_xref),
+                         this->by_source.end ());
+
+  this->by_target = this->by_source;
+  std::sort (this->by_target.begin (), this->by_target.end (), target_less);
+}
+
+/** Writes references recorded while tracing; the rest is built again.
+ */
+void
+XrefTable::save (DatabaseWriter *db) const
+{
+  size_t n;
+
+  db->put_u32 (this->code_refs.size ());
+
+  for (n = 0; n < this->code_refs.size (); n++)
+    {
+      db->put_u32 (this->code_refs[n].source);
+      db->put_u32 (this->code_refs[n].target);
+      db->put_u8 (this->code_refs[n].kind);
+    }
+}
+
+void
+XrefTable::load (DatabaseReader *db)
+{
+  uint32_t count;
+  Xref xref;
+
+  this->clear ();
+
+  for (count = db->get_u32 (); count > 0; count--)
+    {
+      xref.source = db->get_u32 ();
+      xref.target = db->get_u32 ();
+      xref.kind   = db->get_u8 ();
+      this->code_refs.push_back (xref);
+    }
+}
+
+size_t
+XrefTable::size (void) const
+{
+  return this->by_source.size ();
+}
+
+/* Returns references made from given address, sorted by target. */
+const XrefTable::Xref *
+XrefTable::find_from (uint32_t source, size_t *count) const
+{
+  std::vector<Xref>::const_iterator first;
+  std::vector<Xref>::const_iterator last;
+
+  first = std::lower_bound (this->by_source.begin (), this->by_source.end (),
+                            source,
+                            [] (const Xref &xref, uint32_t source)
+                            {
+                              return xref.source < source;
+                            });
+  for (last = first;
+       last != this->by_source.end () and last->source == source; ++last)
+    ;
+
+  *count = last - first;
+  return this->by_source.data () + (first - this->by_source.begin ());
+}
+
+/* Returns references made to given address, sorted by source. */
+const XrefTable::Xref *
+XrefTable::find_to (uint32_t target, size_t *count) const
+{
+  std::vector<Xref>::const_iterator first;
+  std::vector<Xref>::const_iterator last;
+
+  first = std::lower_bound (this->by_target.begin (), this->by_target.end (),
+                            target,
+                            [] (const Xref &xref, uint32_t target)
+                            {
+                              return xref.target < target;
+                            });
+  for (last = first;
+       last != this->by_target.end () and last->target == target; ++last)
+    ;
+
+  *count = last - first;
+  return this->by_target.data () + (first - this->by_target.begin ());
+}
@@ -0,0 +1,75 @@
+/*
+ * le_disasm - Linear Executable disassembler
+ */
+/** @file xref_table.hpp
+ *     Header file for xref_table.cpp, with declaration of XrefTable class.
+ * @par Purpose:
+ *     Storage for XrefTable class, an index of references between code
+ *     and data which can be searched by either end.
+ * @author   zedingCZ <zgalus@centrum.cz>
+ * @date     2026-10-19 - now
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+#ifndef LEDISASM_XREF_TABLE_H
+#define LEDISASM_XREF_TABLE_H
+
+#include <inttypes.h>
+#include <cstddef>
+#include <vector>
+
+class DatabaseReader;
+class DatabaseWriter;
+class LinearExecutable;
+class ShadowMap;
+
+/** Cross references found by tracing and in relocations.
+ *
+ * Calls and jumps are recorded while tracing; pointers come from
+ * relocations, and a pointer within traced code is attributed to the
+ * instruction holding it. The same edges are kept twice, sorted by
+ * source and by target, so both lookups return a contiguous run.
+ */
+class XrefTable
+{
+public:
+  enum Kind
+  {
+    CALL,
+    JUMP,
+    POINTER
+  };
+
+  struct Xref
+  {
+    uint32_t source;
+    uint32_t target;
+    uint8_t  kind;
+  };
+
+protected:
+  std::vector<Xref> code_refs;
+  std::vector<Xref> by_source;
+  std::vector<Xref> by_target;
+
+protected:
+  void compact_code_refs (const ShadowMap *shadow);
+  static uint32_t find_instruction (const ShadowMap *shadow, uint32_t addr);
+
+public:
+  void clear (void);
+  void add_code_ref (uint32_t source, uint32_t target, Kind kind);
+  void build (const LinearExecutable *le, const ShadowMap *shadow);
+
+  void save (DatabaseWriter *db) const;
+  void load (DatabaseReader *db);
+
+  size_t size (void) const;
+  const Xref *find_from (uint32_t source, size_t *count) const;
+  const Xref *find_to (uint32_t target, size_t *count) const;
+};
+
+#endif // LEDISASM_XREF_TABLE_H